@@ -0,0 +1,50 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/*
+  Batch directory.
+
+  A batch (the button pressed with every switch off) renders every config
+  entry into one region, which starts with this directory. Every image
+  follows in a slot aligned to BATCH_ALIGN bytes, at 'offset' bytes from
+  the directory, so downloading 'size' bytes from the directory fetches
+  them all. 'split.host' (host/split.c) writes them out as files.
+
+  A zoom sequence ('frames=<n>;') is written the same way, one slot per
+  frame, and may itself fill the slot of its entry in a batch.
+
+  Every field is an int or a double, so the layout is the same for rv32
+  (ilp32) and x86-64 Linux.
+*/
+#define BATCH_MAGIC 0x424b5444 // "DTKB"
+#define BATCH_VERSION 1
+#define BATCH_ALIGN 64
+
+struct batch_slot {
+  int offset;
+  int size;
+  int index; // of the config entry, which is its switch for the first ten, or of the frame of a zoom sequence
+  int type; // 'M', 'J' or 'S'
+  int fmt;
+  int width;
+  int height;
+  int max_it; // as configured, 0 for 'it=auto'
+  // mandelbrot and julia only, the bounds of a deep zoom are approximate
+  double xmax;
+  double xmin;
+  double ymax;
+  double ymin;
+  // julia only
+  double cx;
+  double cy;
+};
+
+struct batch_directory {
+  unsigned int magic;
+  int version;
+  int count;
+  int size; // of the directory and every slot
+  struct batch_slot slots[];
+};
+
+#endif
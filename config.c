@@ -0,0 +1,657 @@
+#include "config.h"
+
+extern void print(const char*);
+extern void print_dec(unsigned int);
+extern void printc(char);
+
+int progress_step = 10;
+
+// first error of the entry being parsed, 0 if none
+char* error_at = 0;
+const char* error_msg = 0;
+
+// records the first error of the entry, at the given character
+void parse_fail(char* at, const char* msg) {
+  if (error_at == 0) {
+    error_at = at;
+    error_msg = msg;
+  }
+}
+
+// largest int, the firmware has no libc headers
+#define INT_MAX 0x7fffffff
+
+// parses next signed int number in ascii, also moves the cursor to the terminating character of the token
+signed int parse_int(char** ptr) {
+  char* str = *ptr;
+  signed int sign = 1;
+  signed int val = 0;
+
+  //support negative
+  if (*str == '-') {
+    sign = -1;
+    str++;
+  }
+
+  if (*str < '0' || *str > '9') {
+    parse_fail(str, "expected an integer");
+  }
+  while ('0' <= *str && *str <= '9') {
+    int digit = *str - '0';
+    if (val > INT_MAX / 10 || (val == INT_MAX / 10 && digit > INT_MAX % 10)) {
+      parse_fail(str, "integer out of range");
+    } else {
+      val = val * 10 + digit;
+    }
+    str++;
+  }
+
+  *ptr = str;
+  return sign * val;
+}
+
+// exact powers of ten, doubles hold 10^n exactly up to n = 22
+double powers_of_ten[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+  Parses next signed double number in ascii, also moves the cursor to the
+  terminating character of the token.
+
+  Every softfloat operation costs dozens of cycles, so rather than a
+  multiply-add per digit and a division per decimal, the first 18
+  significant digits are accumulated as two 9 digit integers and scaled
+  by a power of ten once. Up to 15 significant digits this is a single,
+  correctly rounded division.
+*/
+double parse_double(char** ptr) {
+  char* str = *ptr;
+  int sign = 1;
+
+  //support negative
+  if (*str == '-') {
+    sign = -1;
+    str++;
+  }
+
+  int hi = 0; // first 9 significant digits
+  int lo = 0; // next 9 significant digits
+  int lo_digits = 0;
+  int digits = 0;
+  int scale = 0; // the value is (hi, lo) / 10^scale
+  int d_seen = 0;
+  int any = 0;
+
+  while (('0' <= *str && *str <= '9') || (*str == '.' && !d_seen)) {
+    if (*str == '.') {
+      d_seen = 1;
+      str++;
+      continue;
+    }
+
+    int digit = *str - '0';
+    any = 1;
+    if (digits == 0 && digit == 0) {
+      // leading zero
+    } else if (digits < 9) {
+      hi = hi * 10 + digit;
+      digits++;
+    } else if (digits < 18) {
+      lo = lo * 10 + digit;
+      lo_digits++;
+      digits++;
+    } else {
+      // beyond what a double holds anyway
+      scale -= 1;
+    }
+    if (d_seen) {
+      scale++;
+    }
+    str++;
+  }
+
+  if (!any) {
+    parse_fail(str, "expected a number");
+  }
+
+  double val = hi;
+  if (lo_digits > 0) {
+    val = val * powers_of_ten[lo_digits] + lo;
+  }
+  while (scale > 22) {
+    val /= powers_of_ten[22];
+    scale -= 22;
+  }
+  while (scale < -22) {
+    val *= powers_of_ten[22];
+    scale += 22;
+  }
+  if (scale > 0) {
+    val /= powers_of_ten[scale];
+  } else if (scale < 0) {
+    val *= powers_of_ten[-scale];
+  }
+
+  *ptr = str;
+  return val*sign;
+}
+
+/*
+  Parses next signed decimal number in ascii of any length to wide fixed
+  point, also moves the cursor to the terminating character of the token.
+
+  The fraction is accumulated from its last digit, adding each digit and
+  dividing by ten, so every digit that wide fixed point can hold counts.
+*/
+void parse_wide(char** ptr, struct wide* val) {
+  char* str = *ptr;
+  int negative = 0;
+
+  //support negative
+  if (*str == '-') {
+    negative = 1;
+    str++;
+  }
+
+  char* start = str;
+  int whole = 0;
+  while ('0' <= *str && *str <= '9') {
+    whole = whole * 10 + (*str - '0');
+    if (whole >= FIX_MAX_COORD) {
+      parse_fail(start, "expected a coordinate between -4 and 4");
+      whole = 0;
+    }
+    str++;
+  }
+  char* frac = str;
+  if (*str == '.') {
+    str++;
+    frac = str;
+    while ('0' <= *str && *str <= '9') {
+      str++;
+    }
+  }
+  if (str == start || (*start == '.' && str == start + 1)) {
+    parse_fail(str, "expected a number");
+  }
+
+  for (int k = 0; k < WIDE_WORDS; k++) {
+    val->w[k] = 0;
+  }
+  for (char* digit = str - 1; digit >= frac; digit--) {
+    val->w[WIDE_TOP] += (*digit - '0') << FIX_FRAC_BITS;
+    wide_div_small(val, 10);
+  }
+  val->w[WIDE_TOP] += whole << FIX_FRAC_BITS;
+  if (negative) {
+    wide_neg(val);
+  }
+
+  *ptr = str;
+}
+
+// parses 'width' or 'widthxheight' in ascii, square if no height is given, also moves the cursor to the terminating character of the token
+void parse_dims(char** ptr, int* width, int* height) {
+  *width = parse_int(ptr);
+  *height = *width;
+  if (**ptr == 'x') {
+    (*ptr)++;
+    *height = parse_int(ptr);
+  }
+}
+
+// moves the cursor past the ';' ending a field
+void parse_sep(char** ptr) {
+  if (**ptr != ';') {
+    parse_fail(*ptr, "expected ';'");
+    return;
+  }
+  (*ptr)++;
+}
+
+// returns 1 and moves the cursor past 'word' if the string at the cursor starts with it
+int parse_word(char** ptr, const char* word) {
+  char* str = *ptr;
+  while (*word != '\0') {
+    if (*str != *word) {
+      return 0;
+    }
+    str++;
+    word++;
+  }
+  *ptr = str;
+  return 1;
+}
+
+// prints the 'key=value' field at the cursor
+void print_field(char* str) {
+  while (*str != ';' && *str != '\0' && *str != '\n') {
+    printc(*str);
+    str++;
+  }
+}
+
+/*
+  Parses the optional 'key=value;' fields trailing a config entry, also moves
+  the cursor past the last field. Supported options are:
+  - 'mode=brute' iterates every pixel (default)
+  - 'mode=ms' uses Mariani-Silver subdivision
+  - 'fmt=ppm' writes a colour PPM image (default)
+  - 'fmt=pgm' writes an indexed PGM image, see 'begin_image'
+  - 'fmt=qoi' writes a QOI compressed colour image
+  - 'it=<n>' iterates at most n times, 2 to 65535 (default 256)
+  - 'it=auto' chooses the iterations per render, see 'choose_max_it'
+  - 'bail=<r>' escapes once |z| >= r, at least 2 (default 2)
+  - 'frames=<n>' renders a zoom sequence of n frames into the bounds' centre, 1 to MAX_FRAMES (default 1),
+    only mandelbrot and julia
+  - 'end=<s>' zooms until the span across the real axis is s (default halving it every frame)
+  and, only if 'deep' is given (mandelbrot), a deep zoom of
+  - 'cx=<x>' and 'cy=<y>' centred on x + iy, any number of digits
+  - 'span=<s>' across the real axis, at least WIDE_MIN_SPAN
+  or, only if 'window' is given (sierpinski), a window of
+  - 'depth=<d>' levels, 2^d cells across, 1 to 30
+  - 'x=<x>' and 'y=<y>' cells from the top left corner
+  - 'size=<s>' cells across
+*/
+struct options parse_options(char** ptr, struct deep* deep, struct window* window) {
+  struct options opts = {
+    MODE_BRUTE,
+    FMT_PPM,
+    IT_DEFAULT,
+    1,
+    2.0,
+    0.0
+  };
+
+  // after an error the rest of the line is not worth a warning
+  while ('a' <= **ptr && **ptr <= 'z' && error_at == 0) {
+    char* field = *ptr;
+    if (parse_word(ptr, "mode=")) {
+      if (parse_word(ptr, "ms;")) {
+        opts.mode = MODE_MARIANI_SILVER;
+        continue;
+      } else if (parse_word(ptr, "brute;")) {
+        opts.mode = MODE_BRUTE;
+        continue;
+      }
+    } else if (parse_word(ptr, "fmt=")) {
+      if (parse_word(ptr, "ppm;")) {
+        opts.fmt = FMT_PPM;
+        continue;
+      } else if (parse_word(ptr, "pgm;")) {
+        opts.fmt = FMT_PGM;
+        continue;
+      } else if (parse_word(ptr, "qoi;")) {
+        opts.fmt = FMT_QOI;
+        continue;
+      }
+    } else if (parse_word(ptr, "it=")) {
+      if (parse_word(ptr, "auto;")) {
+        opts.max_it = IT_AUTO;
+        continue;
+      }
+      char* value = *ptr;
+      opts.max_it = parse_int(ptr);
+      if (opts.max_it < 2 || opts.max_it > IT_MAX) {
+        parse_fail(value, "iterations must be between 2 and 65535");
+      }
+      parse_sep(ptr);
+      continue;
+    } else if (parse_word(ptr, "bail=")) {
+      char* value = *ptr;
+      opts.bail = parse_double(ptr);
+      // below 2 points of the set would escape
+      if (opts.bail < 2.0) {
+        parse_fail(value, "bailout must be at least 2");
+      }
+      parse_sep(ptr);
+      continue;
+    } else if (parse_word(ptr, "frames=")) {
+      char* value = *ptr;
+      opts.frames = parse_int(ptr);
+      if (opts.frames < 1 || opts.frames > MAX_FRAMES) {
+        parse_fail(value, "frames must be between 1 and 1000");
+      }
+      parse_sep(ptr);
+      continue;
+    } else if (parse_word(ptr, "end=")) {
+      char* value = *ptr;
+      opts.end = parse_double(ptr);
+      if (!(opts.end > 0.0)) {
+        parse_fail(value, "end must be a positive span");
+      }
+      parse_sep(ptr);
+      continue;
+    } else if (deep != 0 && parse_word(ptr, "cx=")) {
+      parse_wide(ptr, &deep->cx);
+      deep->enabled = 1;
+      parse_sep(ptr);
+      continue;
+    } else if (deep != 0 && parse_word(ptr, "cy=")) {
+      parse_wide(ptr, &deep->cy);
+      deep->enabled = 1;
+      parse_sep(ptr);
+      continue;
+    } else if (deep != 0 && parse_word(ptr, "span=")) {
+      char* value = *ptr;
+      deep->span = parse_double(ptr);
+      if (!(deep->span >= WIDE_MIN_SPAN)) {
+        parse_fail(value, "span must be at least 1e-50");
+      }
+      deep->enabled = 1;
+      parse_sep(ptr);
+      continue;
+    } else if (window != 0 && parse_word(ptr, "depth=")) {
+      char* value = *ptr;
+      window->depth = parse_int(ptr);
+      if (window->depth < 1 || window->depth > 30) {
+        parse_fail(value, "depth must be between 1 and 30");
+      }
+      parse_sep(ptr);
+      continue;
+    } else if (window != 0 && parse_word(ptr, "x=")) {
+      char* value = *ptr;
+      window->x = parse_int(ptr);
+      if (window->x < 0) {
+        parse_fail(value, "expected a cell, at least 0");
+      }
+      parse_sep(ptr);
+      continue;
+    } else if (window != 0 && parse_word(ptr, "y=")) {
+      char* value = *ptr;
+      window->y = parse_int(ptr);
+      if (window->y < 0) {
+        parse_fail(value, "expected a cell, at least 0");
+      }
+      parse_sep(ptr);
+      continue;
+    } else if (window != 0 && parse_word(ptr, "size=")) {
+      char* value = *ptr;
+      window->size = parse_int(ptr);
+      if (window->size < 1) {
+        parse_fail(value, "size must be at least 1");
+      }
+      parse_sep(ptr);
+      continue;
+    }
+
+    print("[WARNING] Ignoring unknown option '");
+    print_field(field);
+    print("'\n");
+
+    while (**ptr != ';' && **ptr != '\0' && **ptr != '\n') {
+      (*ptr)++;
+    }
+    if (**ptr == ';') {
+      (*ptr)++;
+    }
+  }
+
+  return opts;
+}
+
+// parses next mandelbrot struct in ascii, also moves the cursor to the terminating character of the token
+struct mandelbrot parse_mandelbrot(char** ptr) {
+  double xmax = parse_double(ptr);
+  parse_sep(ptr);
+  double xmin = parse_double(ptr);
+  parse_sep(ptr);
+  double ymax = parse_double(ptr);
+  parse_sep(ptr);
+  double ymin = parse_double(ptr);
+  parse_sep(ptr);
+  int width, height;
+  parse_dims(ptr, &width, &height);
+  parse_sep(ptr);
+
+  // a deep zoom defaults to the view of the bounds, a centre outside of Q4.28 cannot be converted and nothing is left to zoom into there anyway
+  struct deep deep;
+  deep.enabled = 0;
+  double xc = (xmax + xmin) / 2;
+  double yc = (ymax + ymin) / 2;
+  wide_from_double(&deep.cx, fits_fixed_coord(xc) ? xc : 0.0);
+  wide_from_double(&deep.cy, fits_fixed_coord(yc) ? yc : 0.0);
+  deep.span = xmax - xmin;
+  struct options opts = parse_options(ptr, &deep, 0);
+  if (deep.enabled && opts.frames > 1) {
+    parse_fail(*ptr, "a deep zoom cannot be a zoom sequence");
+  }
+  if (deep.enabled && width > 0 && height > 0) {
+    // the bounds only approximate a deep view, for printing and hashing
+    double x = wide_to_double(&deep.cx);
+    double y = wide_to_double(&deep.cy);
+    double span_y = deep.span * height / width;
+    xmax = x + deep.span / 2;
+    xmin = x - deep.span / 2;
+    ymax = y + span_y / 2;
+    ymin = y - span_y / 2;
+  }
+
+  struct mandelbrot data = {
+    'M',
+    xmax,
+    xmin,
+    ymax,
+    ymin,
+    width,
+    height,
+    opts
+  };
+  data.deep = deep;
+  return data;
+}
+
+// parses next julia struct in ascii, also moves the cursor to the terminating character of the token
+struct julia parse_julia(char** ptr) {
+  double xmax = parse_double(ptr);
+  parse_sep(ptr);
+  double xmin = parse_double(ptr);
+  parse_sep(ptr);
+  double ymax = parse_double(ptr);
+  parse_sep(ptr);
+  double ymin = parse_double(ptr);
+  parse_sep(ptr);
+  double real = parse_double(ptr);
+  parse_sep(ptr);
+  double imag = parse_double(ptr);
+  parse_sep(ptr);
+  int width, height;
+  parse_dims(ptr, &width, &height);
+  parse_sep(ptr);
+  struct options opts = parse_options(ptr, 0, 0);
+  struct julia data = {
+    'J',
+    xmax,
+    xmin,
+    ymax,
+    ymin,
+    real,
+    imag,
+    width,
+    height,
+    opts
+  };
+  return data;
+}
+
+// parses next sierpinski struct in ascii, also moves the cursor to the terminating character of the token
+struct sierpinski parse_sierpinski(char** ptr) {
+  int width = 256;
+  int height = 256;
+  if ('0' <= **ptr && **ptr <= '9') {
+    parse_dims(ptr, &width, &height);
+    parse_sep(ptr);
+  }
+
+  // by default every cell is a pixel and the whole triangle fits
+  struct window window = {0, 0, 0, 0};
+  struct options opts = parse_options(ptr, 0, &window);
+  if (opts.frames > 1) {
+    parse_fail(*ptr, "a sierpinski entry cannot be a zoom sequence");
+  }
+  if (window.depth == 0) {
+    window.depth = 1;
+    while (window.depth < 30 && (1 << window.depth) < width) {
+      window.depth++;
+    }
+  }
+  if (window.size == 0) {
+    window.size = 1 << window.depth;
+  }
+
+  struct sierpinski data = {
+    'S',
+    width,
+    height,
+    opts,
+    window
+  };
+  return data;
+}
+
+void begin_cfg(struct cfg_parser* p, char* str) {
+  p->str = str;
+  p->line = 1;
+  p->line_start = str;
+  p->errors = 0;
+}
+
+// prints the first error of the entry with its line and field, counting the type as field 1
+void print_parse_error(struct cfg_parser* p) {
+  int field = 1;
+  for (char* c = p->line_start; c < error_at; c++) {
+    field += *c == ';';
+  }
+
+  print("[SEVERE] Config line ");
+  print_dec(p->line);
+  print(", field ");
+  print_dec(field);
+  print(": ");
+  print(error_msg);
+  if (*error_at == '\n' || *error_at == '\r' || *error_at == '\0') {
+    print(" at the end of the line");
+  } else {
+    print(" at '");
+    print_field(error_at);
+    printc('\'');
+  }
+  print(", the entry is ignored\n");
+}
+
+char parse_entry(struct cfg_parser* p, union cfg_entry* entry) {
+  while (1) {
+    // skip blank lines and blanks between entries
+    char c = *p->str;
+    if (c == '\n') {
+      p->line++;
+      p->line_start = p->str + 1;
+    }
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      p->str++;
+      continue;
+    }
+    if (c == '\0' || c == '#') {
+      return 0;
+    }
+
+    error_at = 0;
+    char* start = p->str;
+    char type = c;
+    p->str++;
+    parse_sep(&p->str);
+    if (type == 'M') {
+      entry->mandelbrot = parse_mandelbrot(&p->str);
+    } else if (type == 'J') {
+      entry->julia = parse_julia(&p->str);
+    } else if (type == 'S') {
+      entry->sierpinski = parse_sierpinski(&p->str);
+    } else if (type == 'B') {
+      entry->type = 'B';
+    } else if (type == 'P') {
+      int step = parse_int(&p->str);
+      parse_sep(&p->str);
+      if (error_at == 0) {
+        progress_step = step;
+      }
+    } else {
+      parse_fail(start, "unknown type");
+    }
+
+    // nothing but blanks may follow an entry on its line
+    while (*p->str == ' ' || *p->str == '\t' || *p->str == '\r') {
+      p->str++;
+    }
+    if (*p->str != '\n' && *p->str != '\0' && *p->str != '#') {
+      parse_fail(p->str, "unexpected field");
+    }
+
+    if (error_at != 0) {
+      print_parse_error(p);
+      p->errors++;
+      while (*p->str != '\n' && *p->str != '\0') {
+        p->str++;
+      }
+      // a malformed directive does not take up a switch
+      if (type == 'P') {
+        continue;
+      }
+      entry->type = '-';
+      return '-';
+    }
+    if (type == 'P') {
+      continue;
+    }
+    prepare_entry(entry);
+    return type;
+  }
+}
+
+// fills the frame for the given view, c is only used by julia views
+void prepare_frame(struct frame* f, double xmax, double xmin, double ymax, double ymin, double cx, double cy, int width, int height, double bail) {
+  // dx and dy
+  f->step_x = (xmax-xmin)/width;
+  f->step_y = (ymax-ymin)/height;
+
+  // Q4.28 only holds orbits that escape at |z| >= 2
+  f->use_fixed = fits_fixed_view(xmax, xmin, ymax, ymin, f->step_x, f->step_y)
+    && fits_fixed_coord(cx) && fits_fixed_coord(cy) && bail == 2.0;
+  // converting a coordinate outside of Q4.28 to int is undefined
+  if (!f->use_fixed) {
+    f->fxmin = 0;
+    f->fymax = 0;
+    f->fwidth = 0;
+    f->fheight = 0;
+    f->fcx = 0;
+    f->fcy = 0;
+    return;
+  }
+  f->fxmin = to_fixed(xmin);
+  f->fymax = to_fixed(ymax);
+  f->fwidth = to_fixed(xmax) - f->fxmin;
+  f->fheight = f->fymax - to_fixed(ymin);
+  f->fcx = to_fixed(cx);
+  f->fcy = to_fixed(cy);
+}
+
+void prepare_entry(union cfg_entry* entry) {
+  if (entry->type == 'M') {
+    struct mandelbrot* m = &entry->mandelbrot;
+    if (m->width > 0 && m->height > 0) {
+      prepare_frame(&m->frame, m->xmax, m->xmin, m->ymax, m->ymin, 0.0, 0.0, m->width, m->height, m->opts.bail);
+      if (m->deep.enabled) {
+        // square pixels, the bounds may have lost the span to rounding
+        m->frame.step_x = m->deep.span / m->width;
+        m->frame.step_y = m->frame.step_x;
+        m->frame.use_fixed = 0;
+      }
+    }
+  } else if (entry->type == 'J') {
+    struct julia* j = &entry->julia;
+    if (j->width > 0 && j->height > 0) {
+      prepare_frame(&j->frame, j->xmax, j->xmin, j->ymax, j->ymin, j->real, j->imag, j->width, j->height, j->opts.bail);
+    }
+  }
+}
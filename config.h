@@ -0,0 +1,150 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/*
+  Configuration.
+
+  The config uploaded to 0x200000 is either text, one entry per line as
+  described in README.md, or a binary config compiled from such text on
+  the host by 'cfgc.host' (host/cfgc.c). A binary config is a 'struct
+  cfg_header' followed by 'count' entries of 'union cfg_entry', which the
+  firmware uses where they are, without parsing anything.
+
+  Every field is an int or a double, so the layout is the same for
+  rv32 (ilp32) and x86-64 Linux, 'entry_size' catches any mismatch.
+*/
+#include "fixed.h"
+
+// render modes selectable per config entry with 'mode=...;'
+#define MODE_BRUTE 0
+#define MODE_MARIANI_SILVER 1
+
+// image formats selectable per config entry with 'fmt=...;'
+#define FMT_PPM 0
+#define FMT_PGM 1
+#define FMT_QOI 2
+
+// iteration limits selectable per config entry with 'it=...;'
+#define IT_AUTO 0
+#define IT_DEFAULT 256
+#define IT_MAX 65535
+
+// longest zoom sequence selectable per config entry with 'frames=...;'
+#define MAX_FRAMES 1000
+
+// optional per config entry settings, given as trailing 'key=value;' fields
+struct options {
+  int mode;
+  int fmt;
+  int max_it; // IT_AUTO to choose per render
+  int frames; // of a zoom sequence, 1 for a single image
+  double bail;
+  double end; // span across the real axis of the last frame, 0 to halve it every frame
+};
+
+// view parameters derived from an entry once, when it is loaded or compiled
+struct frame {
+  double step_x;
+  double step_y;
+  int use_fixed;
+  fixed fxmin;
+  fixed fymax;
+  fixed fwidth;
+  fixed fheight;
+  fixed fcx;
+  fixed fcy;
+};
+
+// deep zoom of a mandelbrot entry, set with 'cx=...;cy=...;span=...;'
+struct deep {
+  int enabled;
+  struct wide cx;
+  struct wide cy;
+  double span; // of the real axis
+};
+
+struct mandelbrot {
+  char type;
+  double xmax;
+  double xmin;
+  double ymax;
+  double ymin;
+  int width;
+  int height;
+  struct options opts;
+  struct frame frame;
+  struct deep deep;
+};
+
+struct julia {
+  char type;
+  double xmax;
+  double xmin;
+  double ymax;
+  double ymin;
+  double real;
+  double imag;
+  int width;
+  int height;
+  struct options opts;
+  struct frame frame;
+};
+
+// window onto the 2^depth by 2^depth cells of a sierpinski entry, set with 'depth=...;x=...;y=...;size=...;'
+struct window {
+  int depth;
+  int x;
+  int y;
+  int size; // cells across the image
+};
+
+struct sierpinski {
+  char type;
+  int width;
+  int height;
+  struct options opts;
+  struct window window;
+};
+
+// any entry, 'type' is 'M', 'J', 'S', 'B' or '-' for an entry that failed to parse
+union cfg_entry {
+  char type;
+  struct mandelbrot mandelbrot;
+  struct julia julia;
+  struct sierpinski sierpinski;
+};
+
+#define CFG_MAGIC 0x434b5444 // "DTKC"
+#define CFG_VERSION 5
+
+struct cfg_header {
+  unsigned int magic;
+  int version;
+  int entry_size; // sizeof(union cfg_entry)
+  int count;
+  int progress_step;
+};
+
+// print progress every this many percent, set with 'P;<percent>;'
+extern int progress_step;
+
+// text config parser state
+struct cfg_parser {
+  char* str;
+  int line;
+  char* line_start;
+  int errors;
+};
+
+void begin_cfg(struct cfg_parser* p, char* str);
+
+// parses the next entry to 'entry' and returns its type, '-' if it is malformed (after printing why) or 0 at the end
+char parse_entry(struct cfg_parser* p, union cfg_entry* entry);
+
+// fills the frame for the given view, c is only used by julia views
+void prepare_frame(struct frame* f, double xmax, double xmin, double ymax, double ymin, double cx, double cy, int width, int height, double bail);
+
+// fills the frame of a mandelbrot or julia entry
+void prepare_entry(union cfg_entry* entry);
+
+#endif
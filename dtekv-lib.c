@@ -1,12 +1,59 @@
 #include "dtekv-lib.h"
+#include "hal.h"
 
-#define JTAG_UART ((volatile unsigned int*) 0x04000040)
-#define JTAG_CTRL ((volatile unsigned int*) 0x04000044)
+/*
+  Console queue.
+
+  Writing to the JTAG UART busy-waits whenever its FIFO is full, which made
+  render time depend on the speed of the terminal. Instead printc only puts
+  bytes in a ring buffer, which is drained by console_poll whenever the UART
+  has space. Renders poll at row and tile boundaries, the idle loop and
+  handle_interrupt poll as well, and only a full queue makes printc wait.
+  Polling also delivers the input of the host build, see hal_poll_input.
+*/
+#define CONSOLE_QUEUE_SIZE 4096 /* Must be a power of two. */
+
+static char console_queue[CONSOLE_QUEUE_SIZE];
+static volatile unsigned int console_head = 0; /* Next byte to enqueue. */
+static volatile unsigned int console_tail = 0; /* Next byte to write to the UART. */
+static volatile int console_draining = 0;      /* Set while console_poll runs. */
+
+void console_poll(void)
+{
+  hal_poll_input();
+
+  /* An interrupt must not drain the queue while we are already doing so. */
+  if (console_draining) return;
+  console_draining = 1;
+
+  unsigned int tail = console_tail;
+  while (tail != console_head) {
+    unsigned int space = hal_uart_space();
+    if (space == 0) break;
+    while (space > 0 && tail != console_head) {
+      hal_uart_write(console_queue[tail & (CONSOLE_QUEUE_SIZE - 1)]);
+      tail++;
+      space--;
+    }
+  }
+  console_tail = tail;
+
+  console_draining = 0;
+}
+
+void console_flush(void)
+{
+  while (console_tail != console_head)
+    console_poll();
+}
 
 void printc(char s)
 {
-    while (((*JTAG_CTRL)&0xffff0000) == 0);
-    *JTAG_UART = s;
+  /* Queue full, wait for the UART to make room. */
+  while (console_head - console_tail == CONSOLE_QUEUE_SIZE)
+    console_poll();
+  console_queue[console_head & (CONSOLE_QUEUE_SIZE - 1)] = s;
+  console_head++;
 }
 
 void print(char *s)
@@ -73,6 +120,7 @@ void handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned ar
   
   print("Exception Address: ");
   print_hex32(arg0); printc('\n');
+  console_flush();
   while (1);
 }
 
@@ -1,4 +1,6 @@
 void printc(char );
+void console_poll(void);
+void console_flush(void);
 void print(char *);
 void print_dec(unsigned int);
 void print_hex32 ( unsigned int);
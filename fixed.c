@@ -0,0 +1,132 @@
+#include "fixed.h"
+
+fixed to_fixed(double x) {
+  double scaled = x * FIX_ONE;
+  if (scaled < 0) {
+    return (fixed) (scaled - 0.5);
+  }
+  return (fixed) (scaled + 0.5);
+}
+
+int fits_fixed_coord(double x) {
+  return x < FIX_MAX_COORD && x > -FIX_MAX_COORD;
+}
+
+int fits_fixed_view(double xmax, double xmin, double ymax, double ymin, double step_x, double step_y) {
+  if (!fits_fixed_coord(xmax) || !fits_fixed_coord(xmin) || !fits_fixed_coord(ymax) || !fits_fixed_coord(ymin)) {
+    return 0;
+  }
+  return step_x * FIX_ONE >= FIX_MIN_STEP && step_y * FIX_ONE >= FIX_MIN_STEP;
+}
+
+void wide_from_double(struct wide* r, double x) {
+  for (int k = 0; k < WIDE_WORDS; k++) {
+    r->w[k] = 0;
+  }
+
+  // whole Q4.28 ulps, rounded down so the rest is positive
+  double scaled = x * FIX_ONE;
+  fixed top = (fixed) scaled;
+  if (top > scaled) {
+    top--;
+  }
+  r->w[WIDE_TOP] = top;
+
+  // a double has 53 bits, two more words hold all of them
+  double rest = scaled - top;
+  for (int k = WIDE_TOP - 1; k >= WIDE_TOP - 2; k--) {
+    rest *= 4294967296.0;
+    unsigned int word = (unsigned int) rest;
+    r->w[k] = word;
+    rest -= word;
+  }
+}
+
+double wide_to_double(struct wide* a) {
+  // the top word is signed, the ones below are positive
+  double x = (fixed) a->w[WIDE_TOP];
+  x += a->w[WIDE_TOP - 1] / 4294967296.0;
+  x += a->w[WIDE_TOP - 2] / 18446744073709551616.0;
+  return x / FIX_ONE;
+}
+
+void wide_neg(struct wide* a) {
+  unsigned int carry = 1;
+  for (int k = 0; k < WIDE_WORDS; k++) {
+    unsigned int word = ~a->w[k] + carry;
+    carry = carry && word == 0;
+    a->w[k] = word;
+  }
+}
+
+void wide_add(struct wide* r, struct wide* a, struct wide* b) {
+  unsigned int carry = 0;
+  for (int k = 0; k < WIDE_WORDS; k++) {
+    unsigned long long sum = (unsigned long long) a->w[k] + b->w[k] + carry;
+    r->w[k] = (unsigned int) sum;
+    carry = sum >> 32;
+  }
+}
+
+void wide_sub(struct wide* r, struct wide* a, struct wide* b) {
+  unsigned int borrow = 0;
+  for (int k = 0; k < WIDE_WORDS; k++) {
+    unsigned long long diff = (unsigned long long) a->w[k] - b->w[k] - borrow;
+    r->w[k] = (unsigned int) diff;
+    borrow = (diff >> 32) != 0;
+  }
+}
+
+/*
+  Schoolbook multiplication of the magnitudes into 2*WIDE_WORDS words,
+  the product of two Q4.252 values is Q8.504 so the result is the middle
+  words shifted right by 28. Only 32x32->64 bit products are used, which
+  rv32im does with mul/mulhu.
+*/
+void wide_mul(struct wide* r, struct wide* a, struct wide* b) {
+  struct wide ua = *a;
+  struct wide ub = *b;
+  int negative = 0;
+  if ((fixed) ua.w[WIDE_TOP] < 0) {
+    wide_neg(&ua);
+    negative = !negative;
+  }
+  if ((fixed) ub.w[WIDE_TOP] < 0) {
+    wide_neg(&ub);
+    negative = !negative;
+  }
+
+  unsigned int p[2 * WIDE_WORDS];
+  for (int k = 0; k < 2 * WIDE_WORDS; k++) {
+    p[k] = 0;
+  }
+  for (int i = 0; i < WIDE_WORDS; i++) {
+    unsigned int carry = 0;
+    for (int j = 0; j < WIDE_WORDS; j++) {
+      unsigned long long t = (unsigned long long) ua.w[i] * ub.w[j] + p[i + j] + carry;
+      p[i + j] = (unsigned int) t;
+      carry = t >> 32;
+    }
+    p[i + WIDE_WORDS] = carry;
+  }
+
+  const int shift = 32 - FIX_FRAC_BITS;
+  for (int k = 0; k < WIDE_WORDS; k++) {
+    r->w[k] = (p[k + WIDE_TOP] >> FIX_FRAC_BITS) | (p[k + WIDE_WORDS] << shift);
+  }
+  if (negative) {
+    wide_neg(r);
+  }
+}
+
+// long division by halfwords, so every step fits in 32 bits
+void wide_div_small(struct wide* a, unsigned int d) {
+  unsigned int rem = 0;
+  for (int k = WIDE_TOP; k >= 0; k--) {
+    unsigned int hi = (rem << 16) | (a->w[k] >> 16);
+    rem = hi % d;
+    unsigned int lo = (rem << 16) | (a->w[k] & 0xffff);
+    rem = lo % d;
+    a->w[k] = ((hi / d) << 16) | (lo / d);
+  }
+}
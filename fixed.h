@@ -0,0 +1,76 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+/*
+  Fixed-point arithmetic.
+
+  DTEK-V has no floating point unit (-march=rv32imzicsr), so every double
+  operation in the escape-time loops is a call into softfloat.a costing dozens
+  of cycles. For views that are not zoomed in very deep we can instead iterate
+  in signed Q4.28 fixed-point, that is 4 integer bits (including sign) and 28
+  fraction bits in a plain 32-bit register, which only needs mul/mulh.
+
+  Products of two Q4.28 values are kept in 64 bits (Q8.56) until they are
+  shifted back, so the squares used by the bailout test cannot overflow.
+*/
+typedef int fixed;
+
+#define FIX_FRAC_BITS 28
+#define FIX_ONE (1 << FIX_FRAC_BITS)
+
+// bailout |z|^2 < 4.0 expressed in Q8.56
+#define FIX_BAILOUT (4LL << (2 * FIX_FRAC_BITS))
+
+// smallest pixel spacing in ulps (2^-28) we accept, keeps 10 bits below a pixel
+#define FIX_MIN_STEP (1 << 10)
+
+// largest view coordinate magnitude, keeps |u|,|v| < 8 for all non-escaped orbits
+#define FIX_MAX_COORD 4.0
+
+// converts a double to Q4.28, rounding to nearest, x must fit (see 'fits_fixed_coord')
+fixed to_fixed(double x);
+
+// returns 1 if the given value is safe to use as a view coordinate in Q4.28
+int fits_fixed_coord(double x);
+
+// returns 1 if the given view can be iterated in Q4.28 without overflow or visible loss of precision
+int fits_fixed_view(double xmax, double xmin, double ymax, double ymin, double step_x, double step_y);
+
+/*
+  Wide fixed-point.
+
+  Deep zooms need a reference orbit far more precise than a double. A wide
+  value is WIDE_WORDS 32-bit words in two's complement, least significant
+  word first. The top word has the 4 integer bits of Q4.28 and every word
+  below it 32 more fraction bits, 252 in all.
+*/
+#define WIDE_WORDS 8
+#define WIDE_TOP (WIDE_WORDS - 1)
+
+// smallest deep zoom span we accept, leaves some 70 bits below a pixel of a 4096 wide image
+#define WIDE_MIN_SPAN 1e-50
+
+struct wide {
+  unsigned int w[WIDE_WORDS];
+};
+
+// x must fit Q4.28, see 'fits_fixed_coord'
+void wide_from_double(struct wide* r, double x);
+
+double wide_to_double(struct wide* a);
+
+void wide_neg(struct wide* a);
+
+// r = a + b, r may be a or b
+void wide_add(struct wide* r, struct wide* a, struct wide* b);
+
+// r = a - b, r may be a or b
+void wide_sub(struct wide* r, struct wide* a, struct wide* b);
+
+// r = a * b truncated, r may not be a or b, the product must be within (-8, 8)
+void wide_mul(struct wide* r, struct wide* a, struct wide* b);
+
+// divides a non-negative a by d < 65536, truncating
+void wide_div_small(struct wide* a, unsigned int d);
+
+#endif
@@ -0,0 +1,119 @@
+#include "hal.h"
+
+#define SWITCHES ((volatile int*) 0x4000010)
+#define SWITCHES_IRQ_MASK ((volatile int*) 0x4000018)
+#define SWITCHES_EDGE ((volatile int*) 0x400001c)
+#define BUTTON_IRQ_MASK ((volatile int*) 0x40000d8)
+#define BUTTON_EDGE ((volatile int*) 0x40000dc)
+#define JTAG_UART ((volatile unsigned int*) 0x04000040)
+#define JTAG_CTRL ((volatile unsigned int*) 0x04000044)
+
+// memcpy if compiler flags -O0 requires it
+void *memcpy(void *dest, const void *src, unsigned n) {
+    for (unsigned i = 0; i < n; i++) {
+        ((char*)dest)[i] = ((char*)src)[i];
+    }
+    return dest;
+}
+
+void hal_init(void) {}
+
+int hal_sw(void) {
+  return *SWITCHES;
+}
+
+void hal_enable_input(void) {
+  // forget edges from before, then interrupt on any switch and the button
+  *SWITCHES_EDGE = 0x3ff;
+  *BUTTON_EDGE = 1;
+  *SWITCHES_IRQ_MASK = 0x3ff;
+  *BUTTON_IRQ_MASK = 1;
+  asm volatile ("csrs mie, %0" : : "r"((1 << HAL_IRQ_SWITCHES) | (1 << HAL_IRQ_BUTTON)));
+  asm volatile ("csrsi mstatus, 8");
+}
+
+void hal_ack_input(unsigned cause) {
+  // writing the edge capture register clears it
+  if (cause == HAL_IRQ_SWITCHES) {
+    *SWITCHES_EDGE = 0x3ff;
+  } else if (cause == HAL_IRQ_BUTTON) {
+    *BUTTON_EDGE = 1;
+  }
+}
+
+void hal_poll_input(void) {
+  // interrupts are taken as they arrive
+}
+
+void hal_wait(volatile int* flag) {
+  // wfi also wakes on an interrupt that is pending while they are disabled, so none is lost between the check and wfi
+  asm volatile ("csrci mstatus, 8");
+  if (!*flag) {
+    asm volatile ("wfi");
+  }
+  asm volatile ("csrsi mstatus, 8");
+}
+
+unsigned int hal_uart_space(void) {
+  // upper half of the control register is the free space in the write FIFO
+  return (*JTAG_CTRL) >> 16;
+}
+
+void hal_uart_write(char c) {
+  *JTAG_UART = c;
+}
+
+void hal_reset_counters(void) {
+  asm volatile ("csrw mcycleh, x0");
+  asm volatile ("csrw mcycle, x0");
+  asm volatile ("csrw minstreth, x0");
+  asm volatile ("csrw minstret, x0");
+  asm volatile ("csrw mhpmcounter3h, x0");
+  asm volatile ("csrw mhpmcounter3, x0");
+  asm volatile ("csrw mhpmcounter4h, x0");
+  asm volatile ("csrw mhpmcounter4, x0");
+  asm volatile ("csrw mhpmcounter5h, x0");
+  asm volatile ("csrw mhpmcounter5, x0");
+  asm volatile ("csrw mhpmcounter6h, x0");
+  asm volatile ("csrw mhpmcounter6, x0");
+  asm volatile ("csrw mhpmcounter7h, x0");
+  asm volatile ("csrw mhpmcounter7, x0");
+  asm volatile ("csrw mhpmcounter8h, x0");
+  asm volatile ("csrw mhpmcounter8, x0");
+  asm volatile ("csrw mhpmcounter9h, x0");
+  asm volatile ("csrw mhpmcounter9, x0");
+}
+
+// combines the two halves of a 64-bit counter
+#define COUNTER(hi, lo) ((((unsigned long long) (hi)) << 32) | (lo))
+
+void hal_read_counters(unsigned long long* counters) {
+  unsigned int hi, lo;
+  asm volatile ("csrr %0, mcycleh" : "=r"(hi));
+  asm volatile ("csrr %0, mcycle" : "=r"(lo));
+  counters[0] = COUNTER(hi, lo);
+  asm volatile ("csrr %0, minstreth" : "=r"(hi));
+  asm volatile ("csrr %0, minstret" : "=r"(lo));
+  counters[1] = COUNTER(hi, lo);
+  asm volatile ("csrr %0, mhpmcounter3h" : "=r"(hi));
+  asm volatile ("csrr %0, mhpmcounter3" : "=r"(lo));
+  counters[2] = COUNTER(hi, lo);
+  asm volatile ("csrr %0, mhpmcounter4h" : "=r"(hi));
+  asm volatile ("csrr %0, mhpmcounter4" : "=r"(lo));
+  counters[3] = COUNTER(hi, lo);
+  asm volatile ("csrr %0, mhpmcounter5h" : "=r"(hi));
+  asm volatile ("csrr %0, mhpmcounter5" : "=r"(lo));
+  counters[4] = COUNTER(hi, lo);
+  asm volatile ("csrr %0, mhpmcounter6h" : "=r"(hi));
+  asm volatile ("csrr %0, mhpmcounter6" : "=r"(lo));
+  counters[5] = COUNTER(hi, lo);
+  asm volatile ("csrr %0, mhpmcounter7h" : "=r"(hi));
+  asm volatile ("csrr %0, mhpmcounter7" : "=r"(lo));
+  counters[6] = COUNTER(hi, lo);
+  asm volatile ("csrr %0, mhpmcounter8h" : "=r"(hi));
+  asm volatile ("csrr %0, mhpmcounter8" : "=r"(lo));
+  counters[7] = COUNTER(hi, lo);
+  asm volatile ("csrr %0, mhpmcounter9h" : "=r"(hi));
+  asm volatile ("csrr %0, mhpmcounter9" : "=r"(lo));
+  counters[8] = COUNTER(hi, lo);
+}
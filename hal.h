@@ -0,0 +1,50 @@
+/*
+  Hardware abstraction layer.
+
+  Everything that touches the board directly (switches, button, JTAG UART
+  and the performance counters) goes through these functions, so the same
+  sources build both for DTEK-V (hal-dtekv.c) and as a native Linux program
+  (host/hal-host.c, see 'make host').
+
+  The fixed memory regions (0x200000 and up) are not abstracted, the host
+  build maps a file at those very addresses instead.
+*/
+
+// number of performance counters, in the order mcycle, minstret, mhpmcounter3..9
+#define HAL_COUNTERS 9
+
+// called first thing in main
+void hal_init(void);
+
+// returns the state of all switches, bit i is switch i
+int hal_sw(void);
+
+// interrupt causes (mcause without its top bit) of the switches and the button
+#define HAL_IRQ_SWITCHES 17
+#define HAL_IRQ_BUTTON 18
+
+// enables the switch and button interrupts, which end up in handle_interrupt
+void hal_enable_input(void);
+
+// acknowledges the switch or button interrupt with the given cause
+void hal_ack_input(unsigned cause);
+
+// delivers input that the host build only flagged in its signal handler, does nothing on the board
+void hal_poll_input(void);
+
+// sleeps until the next interrupt, unless *flag is set, without missing one that arrives in between
+void hal_wait(volatile int* flag);
+
+// called by the interrupt service routine with the cause of every interrupt, see labmain.c
+void handle_interrupt(unsigned cause);
+
+// returns how many bytes the UART can take without blocking
+unsigned int hal_uart_space(void);
+
+// writes one byte to the UART, only call when hal_uart_space() > 0
+void hal_uart_write(char c);
+
+void hal_reset_counters(void);
+
+// reads all HAL_COUNTERS performance counters
+void hal_read_counters(unsigned long long* counters);
@@ -0,0 +1,160 @@
+/*
+  Checks that the render cache never changes an image.
+
+  Usage: cachecheck.host config.txt
+
+  Every single image mandelbrot and julia entry the render cache keeps
+  (up to IT_CACHE_SLOT_SIZE pixels, no deep zoom) is rendered from an
+  empty render cache, and then again right after the same view was
+  rendered in either render mode at half, the same and twice its
+  resolution, which the render may take samples from. Prints how many
+  pixels escape at a different count than from the empty cache. The
+  exit status is 1 if any pixel does.
+
+  The firmware itself (labmain.c) is compiled in, like in render.host.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define main firmware_main
+#include "../labmain.c"
+#undef main
+
+// largest config we check, the config region is 64 KB
+#define CONFIG_MAX 0x10000
+
+void print(const char* s) {
+  fputs(s, stderr);
+}
+
+void print_dec(unsigned int n) {
+  fprintf(stderr, "%u", n);
+}
+
+void print_hex32(unsigned int n) {
+  fprintf(stderr, "0x%08X", n);
+}
+
+void printc(char c) {
+  fputc(c, stderr);
+}
+
+void console_poll(void) {
+}
+
+void console_flush(void) {
+}
+
+// returns the entry at the given resolution and render mode
+union cfg_entry variant(union cfg_entry* entry, int width, int height, int mode) {
+  union cfg_entry e = *entry;
+  if (e.type == 'M') {
+    e.mandelbrot.width = width;
+    e.mandelbrot.height = height;
+    e.mandelbrot.opts.mode = mode;
+  } else {
+    e.julia.width = width;
+    e.julia.height = height;
+    e.julia.opts.mode = mode;
+  }
+  prepare_entry(&e);
+  return e;
+}
+
+// renders the entry with what the render cache holds, sets up *v and leaves its escape counts in 'it_buffer'
+void render_entry(union cfg_entry* entry, struct view* v) {
+  if (entry->type == 'M') {
+    setup_mandelbrot_view(v, &entry->mandelbrot);
+    render_view(v, entry->mandelbrot.opts.mode);
+  } else {
+    setup_julia_view(v, &entry->julia);
+    render_view(v, entry->julia.opts.mode);
+  }
+}
+
+// renders the entry after the other one, returns the number of pixels that differ from 'cold'
+int compare_after(union cfg_entry* entry, union cfg_entry* before, unsigned short* cold) {
+  struct view v;
+  clear_it_cache();
+  render_entry(before, &v);
+  render_entry(entry, &v);
+  int differ = 0;
+  for (int k = 0; k < v.width * v.height; k++) {
+    differ += it_buffer[k] != cold[k];
+  }
+  return differ;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s config.txt\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  static char text[CONFIG_MAX];
+  size_t n = fread(text, 1, CONFIG_MAX - 1, in);
+  text[n] = '\0';
+  fclose(in);
+
+  // the render cache and the render state live in the regions of the board
+  void* mem = mmap(cfg_ptr, bench_end - cfg_ptr, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+  if (mem != cfg_ptr) {
+    perror("cachecheck.host: mmap");
+    return 1;
+  }
+
+  struct cfg_parser parser;
+  begin_cfg(&parser, text);
+  progress_step = 0;
+  int failed = 0;
+  union cfg_entry entry;
+  char type;
+  for (int index = 0; (type = parse_entry(&parser, &entry)) != 0; index++) {
+    if ((type != 'M' && type != 'J') || (type == 'M' ? entry.mandelbrot.opts.frames : entry.julia.opts.frames) > 1
+        || (type == 'M' && entry.mandelbrot.deep.enabled)) {
+      continue;
+    }
+    int width = type == 'M' ? entry.mandelbrot.width : entry.julia.width;
+    int height = type == 'M' ? entry.mandelbrot.height : entry.julia.height;
+    if (width < 1 || height < 1 || width * height > IT_CACHE_SLOT_SIZE) {
+      continue;
+    }
+
+    struct view v;
+    clear_it_cache();
+    render_entry(&entry, &v);
+    unsigned short* cold = malloc(width * height * sizeof *cold);
+    if (cold == NULL) {
+      perror("cachecheck.host");
+      return 1;
+    }
+    for (int k = 0; k < width * height; k++) {
+      cold[k] = it_buffer[k];
+    }
+
+    for (int mode = MODE_BRUTE; mode <= MODE_MARIANI_SILVER; mode++) {
+      for (int scale = 1; scale <= 4; scale *= 2) {
+        // half, the same and twice the resolution
+        int w = width * scale / 2;
+        int h = height * scale / 2;
+        if ((scale == 1 && (width % 2 != 0 || height % 2 != 0)) || w * h > IT_CACHE_SLOT_SIZE) {
+          continue;
+        }
+        union cfg_entry before = variant(&entry, w, h, mode);
+        int differ = compare_after(&entry, &before, cold);
+        printf("entry %d: %c %dx%d after %dx%d %s, %d of %d pixels differ, %s\n", index, type, width, height, w, h,
+               mode == MODE_BRUTE ? "brute" : "ms", differ, width * height, differ > 0 ? "FAILED" : "ok");
+        failed |= differ > 0;
+      }
+    }
+    free(cold);
+  }
+  return failed || parser.errors > 0;
+}
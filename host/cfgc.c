@@ -0,0 +1,84 @@
+/*
+  Compiles a text config to the binary config format, see config.h.
+
+  Usage: cfgc.host config.txt config.bin
+
+  The entries are parsed by the very parser of the firmware (config.c),
+  and their frames are prepared here, so the firmware only has to point
+  at them. Upload the result like a text config:
+  dtekv-upload config.bin 0x200000
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../config.h"
+
+// largest config we compile, the config region is 64 KB
+#define CONFIG_MAX 0x10000
+
+void print(const char* s) {
+  fputs(s, stderr);
+}
+
+void print_dec(unsigned int n) {
+  fprintf(stderr, "%u", n);
+}
+
+void printc(char c) {
+  fputc(c, stderr);
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s config.txt config.bin\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  static char text[CONFIG_MAX];
+  size_t n = fread(text, 1, CONFIG_MAX - 1, in);
+  text[n] = '\0';
+  fclose(in);
+
+  static char table[CONFIG_MAX];
+  struct cfg_header* header = (struct cfg_header*) table;
+  union cfg_entry* entries = (union cfg_entry*) (header + 1);
+  int capacity = (CONFIG_MAX - sizeof *header) / sizeof *entries;
+
+  struct cfg_parser parser;
+  begin_cfg(&parser, text);
+  int count = 0;
+  union cfg_entry entry;
+  while (parse_entry(&parser, &entry) != 0) {
+    if (count == capacity) {
+      fprintf(stderr, "%s: more than %d entries do not fit the config region\n", argv[1], capacity);
+      return 1;
+    }
+    entries[count] = entry;
+    count++;
+  }
+  if (parser.errors > 0) {
+    return 1;
+  }
+
+  header->magic = CFG_MAGIC;
+  header->version = CFG_VERSION;
+  header->entry_size = sizeof(union cfg_entry);
+  header->count = count;
+  header->progress_step = progress_step;
+
+  FILE* out = fopen(argv[2], "wb");
+  if (out == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+  fwrite(table, 1, sizeof *header + count * sizeof *entries, out);
+  fclose(out);
+
+  fprintf(stderr, "%s: compiled %d entries, %zu bytes\n", argv[2], count, sizeof *header + count * sizeof *entries);
+  return 0;
+}
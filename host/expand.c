@@ -0,0 +1,196 @@
+/*
+  Expands an indexed PGM image written with 'fmt=pgm;', or decodes a QOI
+  image written with 'fmt=qoi;', to the PPM image the firmware would have
+  written with 'fmt=ppm;', byte for byte.
+
+  Usage: expand.host in.pgm|in.qoi out.ppm
+
+  Every PGM sample is an escape iteration count minus one (1 byte, or 2
+  big endian bytes if maxval > 255). The '# dtekv <type> <max_it_count>'
+  header comment tells which palette of palette.c to paint it with.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../palette.h"
+
+// skips whitespace and comments, remembering the dtekv comment
+static void skip_space(FILE* f, char* type, int* max_it_count) {
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    if (c == '#') {
+      char line[128];
+      if (fgets(line, sizeof line, f) != NULL) {
+        sscanf(line, " dtekv %c %d", type, max_it_count);
+      }
+    } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+      ungetc(c, f);
+      return;
+    }
+  }
+}
+
+static int read_number(FILE* f, char* type, int* max_it_count) {
+  int n;
+  skip_space(f, type, max_it_count);
+  if (fscanf(f, "%d", &n) != 1) {
+    return -1;
+  }
+  return n;
+}
+
+// expands the PGM image after its 'P5' magic
+static int expand_pgm(FILE* in, const char* name, FILE* out) {
+  char type = '-';
+  int max_it_count = 0;
+  int width = read_number(in, &type, &max_it_count);
+  int height = read_number(in, &type, &max_it_count);
+  int maxval = read_number(in, &type, &max_it_count);
+  // exactly one whitespace byte separates the header from the samples
+  fgetc(in);
+  if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535) {
+    fprintf(stderr, "%s: bad PGM header\n", name);
+    return 1;
+  }
+  if ((type != 'M' && type != 'J' && type != 'S') || max_it_count <= 0) {
+    fprintf(stderr, "%s: missing '# dtekv <type> <max_it_count>' comment\n", name);
+    return 1;
+  }
+
+  fprintf(out, "P6\n%d\n%d\n255\n", width, height);
+
+  int bytes = maxval > 255 ? 2 : 1;
+  char* row = malloc((size_t) width * 3);
+  for (int j = 0; j < height; j++) {
+    char* dst = row;
+    for (int i = 0; i < width; i++) {
+      int sample = fgetc(in);
+      if (bytes == 2) {
+        sample = (sample << 8) | fgetc(in);
+      }
+      if (sample < 0) {
+        fprintf(stderr, "%s: truncated image\n", name);
+        return 1;
+      }
+
+      int it_count = sample + 1;
+      if (type == 'J') {
+        dst = write_julia_pixel(dst, it_count);
+      } else if (type == 'S') {
+        dst = write_sierpinski_pixel(dst, it_count);
+      } else {
+        dst = write_mandelbrot_pixel(dst, it_count, max_it_count);
+      }
+    }
+    fwrite(row, 1, (size_t) width * 3, out);
+  }
+
+  free(row);
+  return 0;
+}
+
+static unsigned int read_u32(FILE* f) {
+  unsigned int n = 0;
+  for (int k = 0; k < 4; k++) {
+    n = (n << 8) | (fgetc(f) & 0xff);
+  }
+  return n;
+}
+
+// decodes the QOI image after its 'qoif' magic, see https://qoiformat.org/qoi-specification.pdf
+static int decode_qoi(FILE* in, const char* name, FILE* out) {
+  unsigned int width = read_u32(in);
+  unsigned int height = read_u32(in);
+  int channels = fgetc(in);
+  fgetc(in);
+  if (width == 0 || height == 0 || width > 0x10000 || height > 0x10000 || channels != 3) {
+    fprintf(stderr, "%s: bad or unsupported QOI header\n", name);
+    return 1;
+  }
+  fprintf(out, "P6\n%u\n%u\n255\n", width, height);
+
+  unsigned char index[64][4] = {{0}};
+  unsigned char px[4] = {0, 0, 0, 255};
+  int run = 0;
+  for (unsigned long n = (unsigned long) width * height; n > 0; n--) {
+    if (run > 0) {
+      run--;
+    } else {
+      int op = fgetc(in);
+      if (op == EOF) {
+        fprintf(stderr, "%s: truncated image\n", name);
+        return 1;
+      }
+      if (op == 0xfe) {
+        px[0] = fgetc(in);
+        px[1] = fgetc(in);
+        px[2] = fgetc(in);
+      } else if (op == 0xff) {
+        px[0] = fgetc(in);
+        px[1] = fgetc(in);
+        px[2] = fgetc(in);
+        px[3] = fgetc(in);
+      } else if ((op & 0xc0) == 0x00) {
+        for (int k = 0; k < 4; k++) {
+          px[k] = index[op][k];
+        }
+      } else if ((op & 0xc0) == 0x40) {
+        px[0] += ((op >> 4) & 3) - 2;
+        px[1] += ((op >> 2) & 3) - 2;
+        px[2] += (op & 3) - 2;
+      } else if ((op & 0xc0) == 0x80) {
+        int next = fgetc(in);
+        int dg = (op & 0x3f) - 32;
+        px[0] += dg - 8 + ((next >> 4) & 0x0f);
+        px[1] += dg;
+        px[2] += dg - 8 + (next & 0x0f);
+      } else {
+        run = op & 0x3f;
+      }
+      int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+      for (int k = 0; k < 4; k++) {
+        index[hash][k] = px[k];
+      }
+    }
+    fwrite(px, 1, 3, out);
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s in.pgm|in.qoi out.ppm\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  char magic[4] = {0};
+  if (fread(magic, 1, 2, in) != 2) {
+    fprintf(stderr, "%s: empty file\n", argv[1]);
+    return 1;
+  }
+  int qoi = magic[0] == 'q' && magic[1] == 'o';
+  if (qoi && (fread(magic + 2, 1, 2, in) != 2 || magic[2] != 'i' || magic[3] != 'f')) {
+    qoi = 0;
+  }
+  if (!qoi && (magic[0] != 'P' || magic[1] != '5')) {
+    fprintf(stderr, "%s: neither a binary PGM (P5) nor a QOI image\n", argv[1]);
+    return 1;
+  }
+
+  FILE* out = fopen(argv[2], "wb");
+  if (out == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  int status = qoi ? decode_qoi(in, argv[1], out) : expand_pgm(in, argv[1], out);
+  fclose(in);
+  fclose(out);
+  return status;
+}
@@ -0,0 +1,186 @@
+/*
+  Compares the Q4.28 kernels against the double kernels.
+
+  Usage: fixcheck.host config.txt
+
+  Every pixel of every single image mandelbrot and julia entry that the
+  firmware iterates in Q4.28 is iterated with both 'mandelbrot_it_fixed'
+  and 'mandelbrot_it_double' (or the julia pair), on the coordinates the
+  firmware sets up for the view. Prints how many pixels escape at a
+  different count and by how much. Culling, mirroring and the render
+  cache are left out, they do not change any count.
+
+  Rounding only adds up along orbits near the boundary of an escape
+  band, so an entry fails if more than MAX_DIFFER_PERMILLE of its pixels
+  differ, or if a pixel away from any boundary (its 3x3 neighbourhood
+  escapes at one count with doubles) differs by more than MAX_FLAT_DELTA
+  iterations. The exit status is 1 if any entry failed.
+
+  The firmware itself (labmain.c) is compiled in, like in render.host.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define main firmware_main
+#include "../labmain.c"
+#undef main
+
+// largest config we check, the config region is 64 KB
+#define CONFIG_MAX 0x10000
+
+// most pixels of an entry that may differ, in 1/1000
+#define MAX_DIFFER_PERMILLE 10
+
+// most iterations a pixel away from any boundary may differ by
+#define MAX_FLAT_DELTA 1
+
+void print(const char* s) {
+  fputs(s, stderr);
+}
+
+void print_dec(unsigned int n) {
+  fprintf(stderr, "%u", n);
+}
+
+void print_hex32(unsigned int n) {
+  fprintf(stderr, "0x%08X", n);
+}
+
+void printc(char c) {
+  fputc(c, stderr);
+}
+
+void console_poll(void) {
+}
+
+void console_flush(void) {
+}
+
+// returns 1 if the pixel and its neighbours escape at the same count with doubles
+int is_flat(struct view* v, int* counts, int i, int j) {
+  if (i == 0 || j == 0 || i == v->width - 1 || j == v->height - 1) {
+    return 0;
+  }
+  int* row = &counts[j * v->width + i];
+  for (int dj = -1; dj <= 1; dj++) {
+    for (int di = -1; di <= 1; di++) {
+      if (row[dj * v->width + di] != row[0]) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// compares both kernels over the view, returns the number of pixels that differ and sets *failed if the entry is past the limits
+int compare_view(struct view* v, int index, int* failed) {
+  int pixels = v->width * v->height;
+  int* fixed_counts = malloc(pixels * sizeof *fixed_counts);
+  int* double_counts = malloc(pixels * sizeof *double_counts);
+  if (fixed_counts == NULL || double_counts == NULL) {
+    perror("fixcheck.host");
+    exit(1);
+  }
+  for (int j = 0; j < v->height; j++) {
+    for (int i = 0; i < v->width; i++) {
+      int k = j * v->width + i;
+      if (v->type == 'J') {
+        fixed_counts[k] = julia_it_fixed(fixed_cols[i], fixed_rows[j], v->fcx, v->fcy, v->max_it_count);
+        double_counts[k] = julia_it_double(double_cols[i], double_rows[j], v->cx, v->cy, v->max_it_count, v->bailout);
+      } else {
+        fixed_counts[k] = mandelbrot_it_fixed(fixed_cols[i], fixed_rows[j], v->max_it_count);
+        double_counts[k] = mandelbrot_it_double(double_cols[i], double_rows[j], v->max_it_count, v->bailout);
+      }
+    }
+  }
+
+  int differ = 0;
+  int most = 0;
+  int flat_most = 0;
+  for (int j = 0; j < v->height; j++) {
+    for (int i = 0; i < v->width; i++) {
+      int k = j * v->width + i;
+      int d = abs(fixed_counts[k] - double_counts[k]);
+      differ += d != 0;
+      most = d > most ? d : most;
+      if (d > flat_most && is_flat(v, double_counts, i, j)) {
+        flat_most = d;
+      }
+    }
+  }
+  free(fixed_counts);
+  free(double_counts);
+
+  int over = differ * 1000LL > (long long) pixels * MAX_DIFFER_PERMILLE || flat_most > MAX_FLAT_DELTA;
+  printf("entry %d: %c %dx%d it=%d, %d of %d pixels differ (%.3f%%), by at most %d iterations, %d away from a boundary, %s\n",
+         index, v->type, v->width, v->height, v->max_it_count, differ, pixels, 100.0 * differ / pixels, most, flat_most,
+         over ? "FAILED" : "ok");
+  *failed |= over;
+  return differ;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s config.txt\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  static char text[CONFIG_MAX];
+  size_t n = fread(text, 1, CONFIG_MAX - 1, in);
+  text[n] = '\0';
+  fclose(in);
+
+  // 'it=auto' probes and deep zoom reference orbits use the render state in the regions of the board
+  void* mem = mmap(cfg_ptr, bench_end - cfg_ptr, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+  if (mem != cfg_ptr) {
+    perror("fixcheck.host: mmap");
+    return 1;
+  }
+
+  struct cfg_parser parser;
+  begin_cfg(&parser, text);
+  progress_step = 0;
+  int differ = 0;
+  int pixels = 0;
+  int failed = 0;
+  union cfg_entry entry;
+  char type;
+  for (int index = 0; (type = parse_entry(&parser, &entry)) != 0; index++) {
+    if ((type != 'M' && type != 'J') || (type == 'M' ? entry.mandelbrot.opts.frames : entry.julia.opts.frames) > 1) {
+      continue;
+    }
+    // the firmware refuses these, the coordinates of a view hold MAX_DIM
+    struct mandelbrot* m = &entry.mandelbrot;
+    struct julia* j = &entry.julia;
+    int width = type == 'M' ? m->width : j->width;
+    int height = type == 'M' ? m->height : j->height;
+    struct options* opts = type == 'M' ? &m->opts : &j->opts;
+    if (!check_dims(width, height, bpp_bound(opts))) {
+      failed = 1;
+      continue;
+    }
+    struct view v;
+    if (type == 'M') {
+      setup_mandelbrot_view(&v, m);
+    } else {
+      setup_julia_view(&v, j);
+    }
+    if (!v.use_fixed) {
+      printf("entry %d: %c is iterated in doubles, nothing to compare\n", index, type);
+      continue;
+    }
+    differ += compare_view(&v, index, &failed);
+    pixels += v.width * v.height;
+  }
+  if (pixels > 0) {
+    printf("total: %d of %d pixels differ (%.3f%%)\n", differ, pixels, 100.0 * differ / pixels);
+  }
+  return failed || parser.errors > 0;
+}
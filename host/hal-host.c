@@ -0,0 +1,218 @@
+/*
+  Linux implementation of the hardware abstraction layer, see hal.h.
+
+  - Memory: the regions of regions.lds, from 0x200000 up to 32 MB, are
+    backed by a file ($DTEKV_MEM, default 'dtekv-mem.bin') mapped at the
+    very same addresses, so they survive between runs just like on the
+    board.
+  - Upload: if $DTEKV_CONFIG names a file it is copied to 0x200000 on start,
+    like 'dtekv-upload <file> 0x200000'.
+  - Switches and button: every line on stdin holds a switch index, which is
+    set before the button is pressed. An empty line presses the button with
+    every switch off. A line is only read once the firmware is idle, unless
+    it starts with '+<ms> ', which presses the button that many
+    milliseconds after the previous press, also in the middle of a render.
+    The program exits at the end of input, once the firmware is idle.
+  - Interrupts: lines are read by a thread, which raises SIGUSR1 in the
+    firmware thread for every press. The signal handler only flags the
+    press, handle_interrupt touches the console queue and is not
+    async-signal-safe. The firmware thread calls it for the flagged press
+    in hal_poll_input, at the row and tile boundaries where renders poll
+    the console, and in hal_wait. Presses that arrive before the firmware
+    polls count as one, like a pending interrupt on the board.
+  - UART: stdout.
+  - Counters: mcycle counts nanoseconds, the others are always 0.
+*/
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../hal.h"
+#include "../dtekv-lib.h"
+
+// the regions of regions.lds
+#define MEM_BASE 0x200000
+#define MEM_END 0x2000000
+
+// largest config we upload, the config region is 64 KB
+#define CONFIG_MAX 0x10000
+
+static volatile int switches = 0;
+static volatile int pressed_switches = 0;
+static volatile sig_atomic_t input_raised = 0;
+static unsigned long long counters_base = 0;
+
+static pthread_t firmware_thread;
+
+// posted every time the firmware goes to sleep in hal_wait
+static sem_t idle;
+
+static unsigned long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void upload_config(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  size_t n = fread((void*) MEM_BASE, 1, CONFIG_MAX - 1, f);
+  ((char*) MEM_BASE)[n] = '\0';
+  fclose(f);
+}
+
+void hal_init(void) {
+  const char* path = getenv("DTEKV_MEM");
+  if (path == NULL) {
+    path = "dtekv-mem.bin";
+  }
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0 || ftruncate(fd, MEM_END - MEM_BASE) != 0) {
+    perror(path);
+    exit(1);
+  }
+  void* mem = mmap((void*) MEM_BASE, MEM_END - MEM_BASE, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+  if (mem != (void*) MEM_BASE) {
+    perror("mmap");
+    exit(1);
+  }
+  close(fd);
+
+  const char* config = getenv("DTEKV_CONFIG");
+  if (config != NULL) {
+    upload_config(config);
+  }
+}
+
+int hal_sw(void) {
+  return switches;
+}
+
+// the signal handler, runs in the firmware thread
+static void raise_input(int sig) {
+  (void) sig;
+  input_raised = 1;
+}
+
+// the interrupt service routine, runs in the firmware thread outside of the signal handler
+void hal_poll_input(void) {
+  if (!input_raised) {
+    return;
+  }
+  // a press between the check and the clear would be lost otherwise
+  sigset_t mask, old;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &mask, &old);
+  input_raised = 0;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (switches != pressed_switches) {
+    switches = pressed_switches;
+    handle_interrupt(HAL_IRQ_SWITCHES);
+  }
+  handle_interrupt(HAL_IRQ_BUTTON);
+}
+
+// presses the button for every line on stdin
+static void* read_input(void* arg) {
+  (void) arg;
+  char line[64];
+  unsigned long long last = now_ns();
+  while (fgets(line, sizeof line, stdin) != NULL) {
+    char* ptr = line;
+    if (*ptr == '+') {
+      long ms = strtol(ptr + 1, &ptr, 10);
+      unsigned long long at = last + ms * 1000000ULL;
+      unsigned long long now = now_ns();
+      if (at > now) {
+        struct timespec ts = { (at - now) / 1000000000ULL, (at - now) % 1000000000ULL };
+        nanosleep(&ts, NULL);
+      }
+    } else {
+      sem_wait(&idle);
+    }
+
+    char* end;
+    long i = strtol(ptr, &end, 10);
+    pressed_switches = (end != ptr && i >= 0 && i < 10) ? 1 << i : 0;
+    last = now_ns();
+    pthread_kill(firmware_thread, SIGUSR1);
+  }
+
+  sem_wait(&idle);
+  exit(0);
+}
+
+void hal_enable_input(void) {
+  sem_init(&idle, 0, 0);
+  firmware_thread = pthread_self();
+
+  struct sigaction sa = { 0 };
+  sa.sa_handler = raise_input;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &sa, NULL);
+
+  // the reader takes no signals, it is not the core
+  sigset_t mask, old;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &mask, &old);
+  pthread_t reader;
+  pthread_create(&reader, NULL, read_input, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void hal_ack_input(unsigned cause) {
+  (void) cause;
+}
+
+void hal_wait(volatile int* flag) {
+  // like wfi with interrupts disabled, a press between the check and the sleep still wakes us
+  sigset_t mask, old;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &mask, &old);
+  hal_poll_input();
+  if (!*flag) {
+    // the user can only react to what has been printed so far
+    fflush(stdout);
+    sem_post(&idle);
+    sigsuspend(&old);
+    hal_poll_input();
+    // a press that came early, while we were still busy, did not need the idle
+    sem_trywait(&idle);
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+unsigned int hal_uart_space(void) {
+  return 0xffff;
+}
+
+void hal_uart_write(char c) {
+  putchar(c);
+}
+
+void hal_reset_counters(void) {
+  counters_base = now_ns();
+}
+
+void hal_read_counters(unsigned long long* counters) {
+  counters[0] = now_ns() - counters_base;
+  for (int i = 1; i < HAL_COUNTERS; i++) {
+    counters[i] = 0;
+  }
+}
@@ -0,0 +1,548 @@
+/*
+  Renders the mandelbrot and julia entries of a text config on every core.
+
+  Usage: render.host config.txt [prefix] [threads]
+
+  Every entry is written to <prefix><entry>.<ppm|pgm|qoi> (the prefix is
+  'image' by default), byte for byte the image the firmware writes for
+  it with an empty render cache, also at sizes that do not fit the image
+  buffer of the board. Sierpinski entries are written as well, zoom
+  sequences are left to the firmware. A 'B;' entry compares the vector
+  kernels of host/vector.c against the firmware's, see 'compare_kernels'.
+
+  The firmware itself (labmain.c) is compiled in, with its render state
+  thread-local, and sets up every view. The frame is cut into the bands
+  of 'render_image', since mirrored pixels depend on the whole band.
+  Brute force bands are cut further into chunks of rows, which are the
+  units of work, so that also a frame of a single band (every frame of
+  up to 256x256 pixels) keeps every thread busy. The rows that an
+  earlier row of their band mirrors pixels into are only taken once
+  every other row is done, so each pixel is iterated or mirrored just
+  like in the firmware. Mariani-Silver renders whole bands, which pixels
+  it fills depends on the order of its tiles.
+
+  Each thread takes units from the top of its own share of the frame,
+  and once that is done steals them from the bottom of the others', so
+  the threads that drew the exterior help out with the interior. The
+  escape counts go to one buffer of the whole frame, which is then
+  painted band by band in order, mirrored bands along with the rows they
+  mirror, exactly like the firmware does.
+
+  Brute force rows are iterated by the vector kernels of host/vector.c
+  where the CPU has one for the view, through the RENDER_ROW hook of
+  'render_brute'.
+*/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+struct view;
+int render_row_vector(struct view* v, int j);
+
+#define main firmware_main
+#define RENDER_LOCAL __thread
+#define RENDER_ROW(v, j) render_row_vector(v, j)
+#include "../labmain.c"
+#undef main
+
+#include "vector.c"
+
+// largest config we render, the config region is 64 KB
+#define CONFIG_MAX 0x10000
+
+void print(const char* s) {
+  fputs(s, stderr);
+}
+
+void print_dec(unsigned int n) {
+  fprintf(stderr, "%u", n);
+}
+
+void print_hex32(unsigned int n) {
+  fprintf(stderr, "0x%08X", n);
+}
+
+void printc(char c) {
+  fputc(c, stderr);
+}
+
+void console_poll(void) {
+}
+
+void console_flush(void) {
+}
+
+// chunks of rows per thread of a brute force frame
+#define ROW_CHUNKS 8
+
+// a band, or rows[first..first+count) of it in brute force mode
+struct unit {
+  int band;
+  int first;
+  int count;
+};
+
+// the units of a frame and the threads rendering them
+struct job {
+  struct view* v;
+  int mode;
+  int band; // rows per band
+  int split; // units are chunks of rows, not whole bands
+  struct unit* units; // those painted from their mirror left out
+  int* rows;
+  unsigned short* counts; // escape counts of the whole frame
+  struct report_rows* costliest; // the costliest rows of every worker
+  int noted;
+  int threads;
+  struct worker* workers;
+};
+
+struct worker {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  int first; // units[first..last) are left to take
+  int last;
+  int stolen;
+  struct job* job;
+  struct render_stats stats;
+  struct render_report report;
+};
+
+// returns the next unit for the worker, its own from the top or another's from the bottom, or -1 once every unit is taken
+int take_unit(struct worker* w) {
+  struct job* job = w->job;
+  int unit = -1;
+  pthread_mutex_lock(&w->lock);
+  if (w->first < w->last) {
+    unit = w->first++;
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  int self = w - job->workers;
+  for (int k = 1; k < job->threads && unit < 0; k++) {
+    struct worker* victim = &job->workers[(self + k) % job->threads];
+    pthread_mutex_lock(&victim->lock);
+    if (victim->first < victim->last) {
+      unit = --victim->last;
+      w->stolen++;
+    }
+    pthread_mutex_unlock(&victim->lock);
+  }
+  return unit;
+}
+
+// sets up the view of band b
+void band_view(struct job* job, int b, struct view* band) {
+  *band = *job->v;
+  band->y0 = b * job->band;
+  band->rows = band->y0 + job->band < band->height ? job->band : band->height - band->y0;
+}
+
+void* run_worker(void* arg) {
+  struct worker* w = arg;
+  struct job* job = w->job;
+  render_report = &w->report;
+
+  int k;
+  while ((k = take_unit(w)) >= 0) {
+    struct unit* u = &job->units[k];
+    struct view band;
+    band_view(job, u->band, &band);
+    it_buffer = job->counts + band.y0 * band.width;
+    if (!job->split) {
+      render_band(&band, job->mode);
+      continue;
+    }
+    for (int r = u->first; r < u->first + u->count; r++) {
+      render_rows(&band, job->rows[r], 1);
+    }
+  }
+  w->stats = stats;
+  return 0;
+}
+
+// returns 1 if an earlier row of the band stores pixels of row j by symmetry, which it must be iterated after
+int row_follows_mirror(struct view* band, int j) {
+  return mirror_rows[j] >= band->y0 && mirror_rows[j] < j;
+}
+
+// adds the units of the band holding the given rows, one band or chunks of rows
+int add_units(struct job* job, int b, int first, int count, int chunk, int units) {
+  if (!job->split) {
+    job->units[units].band = b;
+    units++;
+    return units;
+  }
+  for (int r = first; r < first + count; r += chunk) {
+    job->units[units].band = b;
+    job->units[units].first = r;
+    job->units[units].count = r + chunk < first + count ? chunk : first + count - r;
+    units++;
+  }
+  return units;
+}
+
+// renders the given number of units on every thread, returns how many were stolen
+int run_units(struct job* job, int units) {
+  int threads = job->threads;
+  for (int t = 0; t < threads; t++) {
+    struct worker* w = &job->workers[t];
+    memset(w, 0, sizeof *w);
+    pthread_mutex_init(&w->lock, NULL);
+    w->first = units * t / threads;
+    w->last = units * (t + 1) / threads;
+    w->job = job;
+  }
+  for (int t = 0; t < threads; t++) {
+    if (pthread_create(&job->workers[t].thread, NULL, run_worker, &job->workers[t]) != 0) {
+      perror("render.host");
+      exit(1);
+    }
+  }
+
+  // a worker may still steal from those that are done
+  for (int t = 0; t < threads; t++) {
+    pthread_join(job->workers[t].thread, NULL);
+  }
+  int stolen = 0;
+  for (int t = 0; t < threads; t++) {
+    struct worker* w = &job->workers[t];
+    stats.iterations += w->stats.iterations;
+    stats.period_saved += w->stats.period_saved;
+    stats.culled += w->stats.culled;
+    stats.periodic += w->stats.periodic;
+    stats.filled += w->stats.filled;
+    stats.mirrored += w->stats.mirrored;
+    stats.rebased += w->stats.rebased;
+    for (int k = 0; k < REPORT_ROWS && w->report.rows[k].rows > 0; k++) {
+      job->costliest[job->noted++] = w->report.rows[k];
+    }
+    stolen += w->stolen;
+    pthread_mutex_destroy(&w->lock);
+  }
+  return stolen;
+}
+
+int compare_rows(const void* a, const void* b) {
+  return ((const struct report_rows*) a)->y - ((const struct report_rows*) b)->y;
+}
+
+// renders the view on the given number of threads and paints it to the image, returns how many units were stolen
+int render_parallel(struct view* v, int mode, struct image_writer* img, int threads) {
+  render_report->mode = mode;
+  struct job job;
+  job.v = v;
+  job.mode = mode;
+  job.band = IT_CACHE_SLOT_SIZE / v->width;
+  // every escape count starts out IT_UNKNOWN
+  job.counts = calloc((size_t) v->width * v->height, sizeof *job.counts);
+  job.units = malloc(v->height * sizeof *job.units);
+  job.rows = malloc(v->height * sizeof *job.rows);
+  job.costliest = malloc(2 * threads * REPORT_ROWS * sizeof *job.costliest);
+  job.noted = 0;
+  job.threads = threads;
+  job.workers = calloc(threads, sizeof *job.workers);
+  if (job.counts == NULL || job.units == NULL || job.rows == NULL || job.costliest == NULL || job.workers == NULL) {
+    perror("render.host");
+    exit(1);
+  }
+
+  // bands the firmware paints from their mirror are not rendered
+  int bands = (v->height + job.band - 1) / job.band;
+  int* copied = calloc(bands, sizeof *copied);
+  for (int b = 0; b < bands; b++) {
+    struct view band;
+    band_view(&job, b, &band);
+    copied[b] = band_is_mirrored(&band, img->fmt);
+  }
+
+  // rows that follow their mirror go in a second round, once the rows before them are done
+  job.split = mode != MODE_MARIANI_SILVER;
+  int stolen = 0;
+  for (int late = 0; late <= job.split; late++) {
+    int count = 0;
+    for (int b = 0; b < bands; b++) {
+      struct view band;
+      band_view(&job, b, &band);
+      for (int j = band.y0; j < band.y0 + band.rows && !copied[b]; j++) {
+        count += row_follows_mirror(&band, j) == late;
+      }
+    }
+    int chunk = count / (threads * ROW_CHUNKS) > 0 ? count / (threads * ROW_CHUNKS) : 1;
+
+    int units = 0;
+    int r = 0;
+    for (int b = 0; b < bands; b++) {
+      if (copied[b]) {
+        continue;
+      }
+      struct view band;
+      band_view(&job, b, &band);
+      int first = r;
+      for (int j = band.y0; j < band.y0 + band.rows; j++) {
+        if (row_follows_mirror(&band, j) == late) {
+          job.rows[r++] = j;
+        }
+      }
+      units = add_units(&job, b, first, r - first, chunk, units);
+    }
+    stolen += run_units(&job, units);
+  }
+
+  // the firmware notes rows from the top, so of rows that cost the same the upper one is kept
+  qsort(job.costliest, job.noted, sizeof *job.costliest, compare_rows);
+  for (int k = 0; k < job.noted; k++) {
+    note_rows(job.costliest[k].y, job.costliest[k].rows, job.costliest[k].iterations);
+  }
+
+  // mirrored bands are painted by the rows they mirror, see 'render_image'
+  for (int b = 0; b < bands; b++) {
+    struct view band;
+    band_view(&job, b, &band);
+    for (int j = band.y0; j < band.y0 + band.rows; j++) {
+      copied_rows[j] = 0;
+    }
+    if (copied[b]) {
+      for (int j = band.y0; j < band.y0 + band.rows; j++) {
+        copied_rows[mirror_rows[j]] = 1;
+      }
+    }
+  }
+  for (int b = 0; b < bands; b++) {
+    struct view band;
+    band_view(&job, b, &band);
+    if (skip_mirrored_band(&band, img)) {
+      continue;
+    }
+    it_buffer = job.counts + band.y0 * band.width;
+    paint_band(&band, img);
+    paint_mirrored_rows(&band, img);
+  }
+
+  free(job.costliest);
+  free(job.rows);
+  free(job.units);
+  free(copied);
+  free(job.workers);
+  free(job.counts);
+  return stolen;
+}
+
+// writes the image of an entry to a file named after it, returns 0 if that failed
+int write_image(const char* prefix, int index, int fmt, char* image, int size) {
+  char name[256];
+  const char* ext = fmt == FMT_PGM ? "pgm" : fmt == FMT_QOI ? "qoi" : "ppm";
+  snprintf(name, sizeof name, "%s%d.%s", prefix, index, ext);
+  FILE* out = fopen(name, "wb");
+  if (out == NULL) {
+    perror(name);
+    return 0;
+  }
+  fwrite(image, 1, size, out);
+  fclose(out);
+  return 1;
+}
+
+double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the image of a mandelbrot or julia entry and how it was rendered
+struct render {
+  char* image;
+  int size;
+  double seconds;
+  int stolen;
+  const char* kernel;
+};
+
+// renders the mandelbrot or julia entry to a new image, returns 0 if its size is out of range
+int render_fractal(union cfg_entry* entry, int index, int threads, struct render* r) {
+  int width = entry->type == 'M' ? entry->mandelbrot.width : entry->julia.width;
+  int height = entry->type == 'M' ? entry->mandelbrot.height : entry->julia.height;
+  struct options* opts = entry->type == 'M' ? &entry->mandelbrot.opts : &entry->julia.opts;
+  if (width < 1 || height < 1 || width > MAX_DIM || height > MAX_DIM) {
+    fprintf(stderr, "entry %d: width and height must be within 1 and %d\n", index, MAX_DIM);
+    return 0;
+  }
+  r->image = malloc((size_t) width * height * bpp_bound(opts) + 64);
+  if (r->image == NULL) {
+    perror("render.host");
+    exit(1);
+  }
+
+  double start = now_seconds();
+  reset_counters();
+  reset_render_stats();
+  render_report->index = index;
+  struct view v;
+  if (entry->type == 'M') {
+    setup_mandelbrot_view(&v, &entry->mandelbrot);
+  } else {
+    setup_julia_view(&v, &entry->julia);
+  }
+  struct image_writer img;
+  begin_image(&img, &v, opts->fmt, r->image);
+  r->stolen = render_parallel(&v, opts->mode, &img, threads);
+  r->size = end_image(&img, &v) - r->image;
+  read_counters();
+  print_render_stats();
+  r->seconds = now_seconds() - start;
+  r->kernel = view_kernel(&v, opts->mode);
+  return 1;
+}
+
+// renders the mandelbrot or julia entry to a file, returns 0 if that failed
+int render_entry(union cfg_entry* entry, int index, const char* prefix, int threads) {
+  struct render r;
+  if (!render_fractal(entry, index, threads, &r)) {
+    return 0;
+  }
+  struct options* opts = entry->type == 'M' ? &entry->mandelbrot.opts : &entry->julia.opts;
+  int written = write_image(prefix, index, opts->fmt, r.image, r.size);
+  printf("entry %d: %c %dx%d in %.3f s on %d threads, kernel %s, %.1f M iterations/s, %d units stolen\n",
+         index, entry->type, render_report->width, render_report->height, r.seconds, threads, r.kernel,
+         stats.iterations / r.seconds * 1e-6, r.stolen);
+  free(r.image);
+  return written;
+}
+
+/*
+  Benchmark.
+
+  A 'B;' entry renders every other single image mandelbrot and julia
+  entry twice, first with the firmware's kernels alone and then with the
+  vector kernels, and prints both times and the speedup. The two images
+  must be the same byte for byte, else the benchmark fails. Returns 0 if
+  any entry failed.
+*/
+int compare_kernels(union cfg_entry* entries, int count, int threads) {
+  int vector_double = double_lanes;
+  int vector_fixed = fixed_lanes;
+  double scalar_total = 0.0;
+  double vector_total = 0.0;
+  int failed = 0;
+  printf("benchmark on %d threads, vector kernel %s\n", threads, kernel_name);
+  for (int index = 0; index < count; index++) {
+    union cfg_entry* entry = &entries[index];
+    if ((entry->type != 'M' && entry->type != 'J') ||
+        (entry->type == 'M' ? entry->mandelbrot.opts.frames : entry->julia.opts.frames) > 1) {
+      continue;
+    }
+
+    struct render scalar;
+    double_lanes = 0;
+    fixed_lanes = 0;
+    int rendered = render_fractal(entry, index, threads, &scalar);
+    double_lanes = vector_double;
+    fixed_lanes = vector_fixed;
+    if (!rendered) {
+      failed = 1;
+      continue;
+    }
+    unsigned long long iterations = stats.iterations;
+    struct render vector;
+    render_fractal(entry, index, threads, &vector);
+
+    int same = scalar.size == vector.size && memcmp(scalar.image, vector.image, scalar.size) == 0 && stats.iterations == iterations;
+    printf("[BENCH] entry %d %c %dx%d kernel %s: scalar %.3f s, vector %.3f s, %.2fx speedup, %s\n",
+           index, entry->type, render_report->width, render_report->height, vector.kernel,
+           scalar.seconds, vector.seconds, scalar.seconds / vector.seconds, same ? "identical" : "IMAGES DIFFER");
+    scalar_total += scalar.seconds;
+    vector_total += vector.seconds;
+    failed |= !same;
+    free(scalar.image);
+    free(vector.image);
+  }
+  if (vector_total > 0.0) {
+    printf("[BENCH] total: scalar %.3f s, vector %.3f s, %.2fx speedup\n", scalar_total, vector_total, scalar_total / vector_total);
+  }
+  return !failed;
+}
+
+// renders the sierpinski entry to a file with the firmware as is, it only paints, returns 0 if that failed
+int render_sierpinski(union cfg_entry* entry, int index, const char* prefix) {
+  struct sierpinski* data = &entry->sierpinski;
+  char* image = malloc((size_t) data->width * data->height * 3 + 64);
+  if (image == NULL) {
+    perror("render.host");
+    exit(1);
+  }
+  int size = 0;
+  int written = write_sierpinski_data(*data, image, &size) && write_image(prefix, index, data->opts.fmt, image, size);
+  free(image);
+  return written;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 4) {
+    fprintf(stderr, "usage: %s config.txt [prefix] [threads]\n", argv[0]);
+    return 2;
+  }
+  const char* prefix = argc > 2 ? argv[2] : "image";
+  int threads = argc > 3 ? atoi(argv[3]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  static char text[CONFIG_MAX];
+  size_t n = fread(text, 1, CONFIG_MAX - 1, in);
+  text[n] = '\0';
+  fclose(in);
+
+  // the reference orbit and the render report live in the regions of the board
+  void* mem = mmap(cfg_ptr, bench_end - cfg_ptr, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+  if (mem != cfg_ptr) {
+    perror("render.host: mmap");
+    return 1;
+  }
+
+  // every entry is parsed first, the benchmark renders the others
+  struct cfg_parser parser;
+  begin_cfg(&parser, text);
+  int count = 0;
+  int capacity = 16;
+  union cfg_entry* entries = malloc(capacity * sizeof *entries);
+  while (entries != NULL && (entries[count].type = parse_entry(&parser, &entries[count])) != 0) {
+    if (++count == capacity) {
+      capacity *= 2;
+      entries = realloc(entries, capacity * sizeof *entries);
+    }
+  }
+  if (entries == NULL) {
+    perror("render.host");
+    return 1;
+  }
+
+  choose_kernels();
+  // progress is not printed from several threads
+  progress_step = 0;
+  int failed = 0;
+  for (int index = 0; index < count; index++) {
+    union cfg_entry* entry = &entries[index];
+    char type = entry->type;
+    if (type == 'S') {
+      failed |= !render_sierpinski(entry, index, prefix);
+    } else if (type == 'B') {
+      failed |= !compare_kernels(entries, count, threads);
+    } else if ((type == 'M' || type == 'J') && (type == 'M' ? entry->mandelbrot.opts.frames : entry->julia.opts.frames) > 1) {
+      fprintf(stderr, "entry %d: skipping the zoom sequence, render it on the board\n", index);
+    } else if (type == 'M' || type == 'J') {
+      failed |= !render_entry(entry, index, prefix, threads);
+    }
+  }
+  free(entries);
+  return failed || parser.errors > 0;
+}
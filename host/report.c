@@ -0,0 +1,76 @@
+/*
+  Prints a render report, see report.h.
+
+  Usage: report.host report.bin
+
+  The report is downloaded with the address and size the firmware
+  prints when a render is done:
+  dtekv-download report.bin 0x248000 <size>
+  Every non-empty histogram bucket is printed, as the escape counts it
+  holds and the number of pixels.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../config.h"
+#include "../report.h"
+
+int main(int argc, char** argv) {
+  static const char* names[HAL_COUNTERS] = {
+    "cycles", "instret", "mem", "icache_miss", "dcache_miss", "icache_stall", "dcache_stall", "hazard_stall", "alu_stall"
+  };
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s report.bin\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  struct render_report r;
+  size_t length = fread(&r, 1, sizeof r, in);
+  fclose(in);
+  if (length < sizeof r || r.magic != REPORT_MAGIC || r.version != REPORT_VERSION || r.size != (int) sizeof r) {
+    fprintf(stderr, "%s: not a report of this version, download all '%d' bytes\n", argv[1], (int) sizeof r);
+    return 1;
+  }
+
+  printf("entry %d: %c %dx%d", r.index, r.type, r.width, r.height);
+  if (r.frames > 1) {
+    printf(", %d frames", r.frames);
+  }
+  printf(", kernel %c, %s, it=%d\n", r.kernel, r.mode == MODE_MARIANI_SILVER ? "ms" : "brute", r.max_it);
+  printf("pixels %d: interior %d, escaped %d\n", r.pixels, r.interior, r.escaped);
+  printf("iterations %llu, %.2f per pixel, periodicity saved %llu\n",
+         r.iterations, r.pixels > 0 ? (double) r.iterations / r.pixels : 0.0, r.period_saved);
+  printf("culled %d, periodic %d, filled %d, reused %d, mirrored %d\n",
+         r.culled, r.periodic, r.filled, r.reused, r.mirrored);
+  for (int i = 0; i < HAL_COUNTERS; i++) {
+    printf("%-13s %llu (%.2f per pixel)\n", names[i], r.counters[i], r.pixels > 0 ? (double) r.counters[i] / r.pixels : 0.0);
+  }
+
+  printf("costliest rows:\n");
+  for (int k = 0; k < REPORT_ROWS && r.rows[k].rows > 0; k++) {
+    printf("  %d..%d: %llu iterations\n", r.rows[k].y, r.rows[k].y + r.rows[k].rows - 1, r.rows[k].iterations);
+  }
+
+  printf("escape counts:\n");
+  int seen = 0;
+  for (int b = 0; b < REPORT_BUCKETS; b++) {
+    if (r.histogram[b] == 0) {
+      continue;
+    }
+    seen += r.histogram[b];
+    int first = b * r.bucket_width + 1;
+    int last = (b + 1) * r.bucket_width;
+    if (first == last) {
+      printf("  %d: %d", first, r.histogram[b]);
+    } else {
+      printf("  %d..%d: %d", first, last, r.histogram[b]);
+    }
+    printf(" (%.1f%% of escaped so far)\n", r.escaped > 0 ? 100.0 * seen / r.escaped : 0.0);
+  }
+  return 0;
+}
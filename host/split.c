@@ -0,0 +1,98 @@
+/*
+  Splits a batch, see batch.h, into one file per image.
+
+  Usage: split.host batch.bin [prefix]
+
+  The batch is downloaded in one go with the address and size the
+  firmware prints when it is done:
+  dtekv-download batch.bin <address> <size>
+  Every image is written to <prefix><entry>.<ppm|pgm|qoi> (the prefix is
+  'image' by default), 'expand.host' turns PGM and QOI images into PPM.
+
+  A zoom sequence is a batch of its frames, which are written to
+  <prefix><frame>.<ext>, or to <prefix><entry>_<frame>.<ext> when the
+  sequence is itself an entry of a batch.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../batch.h"
+#include "../config.h"
+
+// writes every image of the batch, which is 'length' bytes, returns 1 if it is intact
+int split(const char* file, char* batch, long length, const char* prefix) {
+  struct batch_directory* dir = (struct batch_directory*) batch;
+  if (length < (long) sizeof *dir || dir->magic != BATCH_MAGIC || dir->version != BATCH_VERSION) {
+    fprintf(stderr, "%s: not a batch of this version\n", file);
+    return 0;
+  }
+  if (dir->count < 0 || sizeof *dir + dir->count * sizeof(struct batch_slot) > (size_t) length || dir->size > length) {
+    fprintf(stderr, "%s: truncated batch, download all '%d' bytes\n", file, dir->size);
+    return 0;
+  }
+
+  for (int k = 0; k < dir->count; k++) {
+    struct batch_slot* slot = &dir->slots[k];
+    if (slot->offset < 0 || slot->size < 0 || slot->offset > length - slot->size) {
+      fprintf(stderr, "%s: slot %d lies outside the batch\n", file, k);
+      return 0;
+    }
+
+    char name[256];
+    struct batch_directory* nested = (struct batch_directory*) (batch + slot->offset);
+    if (slot->size >= (int) sizeof *nested && nested->magic == BATCH_MAGIC) {
+      snprintf(name, sizeof name, "%s%d_", prefix, slot->index);
+      if (!split(file, batch + slot->offset, slot->size, name)) {
+        return 0;
+      }
+      continue;
+    }
+
+    const char* ext = slot->fmt == FMT_PGM ? "pgm" : slot->fmt == FMT_QOI ? "qoi" : "ppm";
+    snprintf(name, sizeof name, "%s%d.%s", prefix, slot->index, ext);
+    FILE* out = fopen(name, "wb");
+    if (out == NULL) {
+      perror(name);
+      return 0;
+    }
+    fwrite(batch + slot->offset, 1, slot->size, out);
+    fclose(out);
+
+    printf("%s: %c %dx%d, %d bytes", name, slot->type, slot->width, slot->height, slot->size);
+    if (slot->type == 'M' || slot->type == 'J') {
+      printf(", x %.17g..%.17g, y %.17g..%.17g", slot->xmin, slot->xmax, slot->ymin, slot->ymax);
+    }
+    if (slot->type == 'J') {
+      printf(", c %.17g%+.17gi", slot->cx, slot->cy);
+    }
+    printf("\n");
+  }
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "usage: %s batch.bin [prefix]\n", argv[0]);
+    return 2;
+  }
+  const char* prefix = argc == 3 ? argv[2] : "image";
+
+  FILE* in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  fseek(in, 0, SEEK_END);
+  long length = ftell(in);
+  fseek(in, 0, SEEK_SET);
+  char* batch = malloc(length > 0 ? length : 1);
+  if (fread(batch, 1, length, in) != (size_t) length) {
+    perror(argv[1]);
+    return 1;
+  }
+  fclose(in);
+
+  int ok = split(argv[1], batch, length, prefix);
+  free(batch);
+  return ok ? 0 : 1;
+}
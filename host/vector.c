@@ -0,0 +1,483 @@
+/*
+  Vector kernels of render.host, compiled as part of host/render.c.
+
+  Brute force rows of double and Q4.28 views are iterated a group of
+  pixels at a time, one pixel per lane of an SSE2 (2 doubles), AVX2 (4)
+  or AVX-512 (8) register. Every lane runs exactly the arithmetic of
+  'mandelbrot_it_double', 'julia_it_double', 'mandelbrot_it_fixed' and
+  'julia_it_fixed' in the same order, so it ends with the same escape
+  count. A lane that escapes, runs out of iterations or is found
+  periodic is masked off, and the group is done once every lane is.
+  The lanes of a group start together, so they share the period of
+  their periodicity check.
+
+  Q4.28 products need a signed 32 by 32 bit multiply, which SSE2 does
+  not have, so with SSE2 Q4.28 views keep the interleaved kernel of the
+  firmware. Deep zooms and Mariani-Silver renders are left to the
+  firmware's kernels too.
+
+  The widest kernel the CPU supports is chosen on start from CPUID.
+  $DTEKV_KERNEL set to 'scalar', 'sse2' or 'avx2' caps the choice.
+*/
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include <string.h>
+
+#define VECTOR_MAX 8
+
+// pixels of a row iterated together, lanes past 'count' are padding that escapes at once
+struct vector_group {
+  int count;
+  int i[VECTOR_MAX]; // columns
+  double u[VECTOR_MAX]; // z_0 and c of double views
+  double v[VECTOR_MAX];
+  double cx[VECTOR_MAX];
+  double cy[VECTOR_MAX];
+  long long fu[VECTOR_MAX]; // z_0 and c of Q4.28 views, sign extended
+  long long fv[VECTOR_MAX];
+  long long fcx[VECTOR_MAX];
+  long long fcy[VECTOR_MAX];
+  long long round[VECTOR_MAX]; // added to negative 2uv, see 'mandelbrot_it_fixed'
+  int it_count[VECTOR_MAX];
+  int periodic[VECTOR_MAX];
+};
+
+// chosen by 'choose_kernels', 0 lanes where the firmware's kernels are used
+const char* kernel_name = "scalar";
+int double_lanes = 0;
+int fixed_lanes = 0;
+void (*double_kernel)(struct vector_group* g, int max_it_count, double bailout);
+void (*fixed_kernel)(struct vector_group* g, int max_it_count);
+
+// ends the lanes set in 'lanes' after 'it_count' iterations
+static void finish_lanes(struct vector_group* g, int lanes, int it_count, int periodic) {
+  for (int k = 0; lanes != 0; k++, lanes >>= 1) {
+    if (lanes & 1) {
+      g->it_count[k] = it_count;
+      g->periodic[k] = periodic;
+    }
+  }
+}
+
+#if defined(__x86_64__)
+
+// 64-bit lanes of d within [-eps,eps], all ones or zeros, SSE2 has no 64-bit compare
+static inline __m128i near_epi64_sse2(__m128i d, int eps) {
+  // d + eps within [0,2 eps] has a zero high half and a low half of at most 2 eps
+  __m128i t = _mm_add_epi64(d, _mm_set1_epi64x(eps));
+  __m128i high_zero = _mm_cmpeq_epi32(t, _mm_setzero_si128());
+  __m128i sign = _mm_set1_epi32(0x80000000);
+  __m128i low_big = _mm_cmpgt_epi32(_mm_xor_si128(t, sign), _mm_xor_si128(_mm_set1_epi32(2 * eps), sign));
+  high_zero = _mm_shuffle_epi32(high_zero, _MM_SHUFFLE(3, 3, 1, 1));
+  low_big = _mm_shuffle_epi32(low_big, _MM_SHUFFLE(2, 2, 0, 0));
+  return _mm_andnot_si128(low_big, high_zero);
+}
+
+static void iterate_double_sse2(struct vector_group* g, int max_it_count, double bailout) {
+  __m128d u = _mm_loadu_pd(g->u);
+  __m128d v = _mm_loadu_pd(g->v);
+  __m128d cx = _mm_loadu_pd(g->cx);
+  __m128d cy = _mm_loadu_pd(g->cy);
+  __m128d two = _mm_set1_pd(2.0);
+  __m128d bail = _mm_set1_pd(bailout);
+  __m128d u2 = _mm_mul_pd(u, u);
+  __m128d v2 = _mm_mul_pd(v, v);
+  __m128d pu = u;
+  __m128d pv = v;
+  int period = 0;
+  int period_len = PERIOD_START;
+  int active = 0x3;
+
+  for (int it_count = 1; ; it_count++) {
+    int inside = _mm_movemask_pd(_mm_cmplt_pd(_mm_add_pd(u2, v2), bail));
+    if (max_it_count <= it_count) {
+      inside = 0;
+    }
+    finish_lanes(g, active & ~inside, it_count, 0);
+    active &= inside;
+    if (active == 0) {
+      return;
+    }
+
+    v = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(two, u), v), cy);
+    u = _mm_add_pd(_mm_sub_pd(u2, v2), cx);
+    u2 = _mm_mul_pd(u, u);
+    v2 = _mm_mul_pd(v, v);
+
+    __m128i near_u = near_epi64_sse2(_mm_sub_epi64(_mm_castpd_si128(u), _mm_castpd_si128(pu)), DOUBLE_PERIOD_EPS);
+    __m128i near_v = near_epi64_sse2(_mm_sub_epi64(_mm_castpd_si128(v), _mm_castpd_si128(pv)), DOUBLE_PERIOD_EPS);
+    int near = _mm_movemask_pd(_mm_castsi128_pd(_mm_and_si128(near_u, near_v)))
+      & _mm_movemask_pd(_mm_cmplt_pd(_mm_add_pd(u2, v2), bail));
+    finish_lanes(g, active & near, it_count, 1);
+    active &= ~near;
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
+    }
+  }
+}
+
+// 64-bit lanes of d outside [-eps,eps], all ones or zeros
+__attribute__((target("avx2")))
+static inline __m256i far_epi64_avx2(__m256i d, int eps) {
+  return _mm256_or_si256(_mm256_cmpgt_epi64(d, _mm256_set1_epi64x(eps)), _mm256_cmpgt_epi64(_mm256_set1_epi64x(-eps), d));
+}
+
+__attribute__((target("avx2")))
+static void iterate_double_avx2(struct vector_group* g, int max_it_count, double bailout) {
+  __m256d u = _mm256_loadu_pd(g->u);
+  __m256d v = _mm256_loadu_pd(g->v);
+  __m256d cx = _mm256_loadu_pd(g->cx);
+  __m256d cy = _mm256_loadu_pd(g->cy);
+  __m256d two = _mm256_set1_pd(2.0);
+  __m256d bail = _mm256_set1_pd(bailout);
+  __m256d u2 = _mm256_mul_pd(u, u);
+  __m256d v2 = _mm256_mul_pd(v, v);
+  __m256d pu = u;
+  __m256d pv = v;
+  int period = 0;
+  int period_len = PERIOD_START;
+  int active = 0xf;
+
+  for (int it_count = 1; ; it_count++) {
+    int inside = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_add_pd(u2, v2), bail, _CMP_LT_OQ));
+    if (max_it_count <= it_count) {
+      inside = 0;
+    }
+    finish_lanes(g, active & ~inside, it_count, 0);
+    active &= inside;
+    if (active == 0) {
+      return;
+    }
+
+    v = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, u), v), cy);
+    u = _mm256_add_pd(_mm256_sub_pd(u2, v2), cx);
+    u2 = _mm256_mul_pd(u, u);
+    v2 = _mm256_mul_pd(v, v);
+
+    __m256i far_u = far_epi64_avx2(_mm256_sub_epi64(_mm256_castpd_si256(u), _mm256_castpd_si256(pu)), DOUBLE_PERIOD_EPS);
+    __m256i far_v = far_epi64_avx2(_mm256_sub_epi64(_mm256_castpd_si256(v), _mm256_castpd_si256(pv)), DOUBLE_PERIOD_EPS);
+    int near = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_or_si256(far_u, far_v)))
+      & _mm256_movemask_pd(_mm256_cmp_pd(_mm256_add_pd(u2, v2), bail, _CMP_LT_OQ));
+    finish_lanes(g, active & near, it_count, 1);
+    active &= ~near;
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
+    }
+  }
+}
+
+// the low 32 bits of each 64-bit lane are the Q4.28 value, products take them signed
+__attribute__((target("avx2")))
+static void iterate_fixed_avx2(struct vector_group* g, int max_it_count) {
+  __m256i u = _mm256_loadu_si256((__m256i*) g->fu);
+  __m256i v = _mm256_loadu_si256((__m256i*) g->fv);
+  __m256i cx = _mm256_loadu_si256((__m256i*) g->fcx);
+  __m256i cy = _mm256_loadu_si256((__m256i*) g->fcy);
+  __m256i round = _mm256_loadu_si256((__m256i*) g->round);
+  __m256i bail = _mm256_set1_epi64x(FIX_BAILOUT);
+  __m256i zero = _mm256_setzero_si256();
+  __m256i eps = _mm256_set1_epi32(FIX_PERIOD_EPS);
+  __m256i neg_eps = _mm256_set1_epi32(-FIX_PERIOD_EPS);
+  __m256i u2 = _mm256_mul_epi32(u, u);
+  __m256i v2 = _mm256_mul_epi32(v, v);
+  __m256i pu = u;
+  __m256i pv = v;
+  int period = 0;
+  int period_len = PERIOD_START;
+  int active = 0xf;
+
+  for (int it_count = 1; ; it_count++) {
+    int inside = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(bail, _mm256_add_epi64(u2, v2))));
+    if (max_it_count <= it_count) {
+      inside = 0;
+    }
+    finish_lanes(g, active & ~inside, it_count, 0);
+    active &= inside;
+    if (active == 0) {
+      return;
+    }
+
+    // the low 32 bits of a shift are the same whether it is arithmetic or not
+    __m256i uv = _mm256_mul_epi32(u, v);
+    uv = _mm256_add_epi64(uv, _mm256_and_si256(_mm256_cmpgt_epi64(zero, uv), round));
+    v = _mm256_add_epi64(_mm256_srli_epi64(uv, FIX_FRAC_BITS - 1), cy);
+    u = _mm256_add_epi64(_mm256_srli_epi64(_mm256_sub_epi64(u2, v2), FIX_FRAC_BITS), cx);
+    u2 = _mm256_mul_epi32(u, u);
+    v2 = _mm256_mul_epi32(v, v);
+
+    // 'near_fixed' compares 32-bit differences, the low half of each lane decides
+    __m256i du = _mm256_sub_epi32(u, pu);
+    __m256i dv = _mm256_sub_epi32(v, pv);
+    __m256i far = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(du, eps), _mm256_cmpgt_epi32(neg_eps, du)),
+                                  _mm256_or_si256(_mm256_cmpgt_epi32(dv, eps), _mm256_cmpgt_epi32(neg_eps, dv)));
+    far = _mm256_shuffle_epi32(far, _MM_SHUFFLE(2, 2, 0, 0));
+    int near = ~_mm256_movemask_pd(_mm256_castsi256_pd(far))
+      & _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(bail, _mm256_add_epi64(u2, v2))));
+    finish_lanes(g, active & near, it_count, 1);
+    active &= ~near;
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+static void iterate_double_avx512(struct vector_group* g, int max_it_count, double bailout) {
+  __m512d u = _mm512_loadu_pd(g->u);
+  __m512d v = _mm512_loadu_pd(g->v);
+  __m512d cx = _mm512_loadu_pd(g->cx);
+  __m512d cy = _mm512_loadu_pd(g->cy);
+  __m512d two = _mm512_set1_pd(2.0);
+  __m512d bail = _mm512_set1_pd(bailout);
+  __m512i eps = _mm512_set1_epi64(DOUBLE_PERIOD_EPS);
+  __m512i neg_eps = _mm512_set1_epi64(-DOUBLE_PERIOD_EPS);
+  __m512d u2 = _mm512_mul_pd(u, u);
+  __m512d v2 = _mm512_mul_pd(v, v);
+  __m512d pu = u;
+  __m512d pv = v;
+  int period = 0;
+  int period_len = PERIOD_START;
+  int active = 0xff;
+
+  for (int it_count = 1; ; it_count++) {
+    int inside = _mm512_cmp_pd_mask(_mm512_add_pd(u2, v2), bail, _CMP_LT_OQ);
+    if (max_it_count <= it_count) {
+      inside = 0;
+    }
+    finish_lanes(g, active & ~inside, it_count, 0);
+    active &= inside;
+    if (active == 0) {
+      return;
+    }
+
+    v = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, u), v), cy);
+    u = _mm512_add_pd(_mm512_sub_pd(u2, v2), cx);
+    u2 = _mm512_mul_pd(u, u);
+    v2 = _mm512_mul_pd(v, v);
+
+    __m512i du = _mm512_sub_epi64(_mm512_castpd_si512(u), _mm512_castpd_si512(pu));
+    __m512i dv = _mm512_sub_epi64(_mm512_castpd_si512(v), _mm512_castpd_si512(pv));
+    int far = _mm512_cmpgt_epi64_mask(du, eps) | _mm512_cmpgt_epi64_mask(neg_eps, du)
+      | _mm512_cmpgt_epi64_mask(dv, eps) | _mm512_cmpgt_epi64_mask(neg_eps, dv);
+    int near = ~far & _mm512_cmp_pd_mask(_mm512_add_pd(u2, v2), bail, _CMP_LT_OQ);
+    finish_lanes(g, active & near, it_count, 1);
+    active &= ~near;
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+static void iterate_fixed_avx512(struct vector_group* g, int max_it_count) {
+  __m512i u = _mm512_loadu_si512(g->fu);
+  __m512i v = _mm512_loadu_si512(g->fv);
+  __m512i cx = _mm512_loadu_si512(g->fcx);
+  __m512i cy = _mm512_loadu_si512(g->fcy);
+  __m512i round = _mm512_loadu_si512(g->round);
+  __m512i bail = _mm512_set1_epi64(FIX_BAILOUT);
+  __m512i zero = _mm512_setzero_si512();
+  __m512i eps = _mm512_set1_epi64(FIX_PERIOD_EPS);
+  __m512i neg_eps = _mm512_set1_epi64(-FIX_PERIOD_EPS);
+  __m512i u2 = _mm512_mul_epi32(u, u);
+  __m512i v2 = _mm512_mul_epi32(v, v);
+  __m512i pu = u;
+  __m512i pv = v;
+  int period = 0;
+  int period_len = PERIOD_START;
+  int active = 0xff;
+
+  for (int it_count = 1; ; it_count++) {
+    int inside = _mm512_cmpgt_epi64_mask(bail, _mm512_add_epi64(u2, v2));
+    if (max_it_count <= it_count) {
+      inside = 0;
+    }
+    finish_lanes(g, active & ~inside, it_count, 0);
+    active &= inside;
+    if (active == 0) {
+      return;
+    }
+
+    __m512i uv = _mm512_mul_epi32(u, v);
+    uv = _mm512_mask_add_epi64(uv, _mm512_cmpgt_epi64_mask(zero, uv), uv, round);
+    v = _mm512_add_epi64(_mm512_srli_epi64(uv, FIX_FRAC_BITS - 1), cy);
+    u = _mm512_add_epi64(_mm512_srli_epi64(_mm512_sub_epi64(u2, v2), FIX_FRAC_BITS), cx);
+    u2 = _mm512_mul_epi32(u, u);
+    v2 = _mm512_mul_epi32(v, v);
+
+    // 'near_fixed' compares 32-bit differences, sign extended from the low half of each lane
+    __m512i du = _mm512_srai_epi64(_mm512_slli_epi64(_mm512_sub_epi32(u, pu), 32), 32);
+    __m512i dv = _mm512_srai_epi64(_mm512_slli_epi64(_mm512_sub_epi32(v, pv), 32), 32);
+    int far = _mm512_cmpgt_epi64_mask(du, eps) | _mm512_cmpgt_epi64_mask(neg_eps, du)
+      | _mm512_cmpgt_epi64_mask(dv, eps) | _mm512_cmpgt_epi64_mask(neg_eps, dv);
+    int near = ~far & _mm512_cmpgt_epi64_mask(bail, _mm512_add_epi64(u2, v2));
+    finish_lanes(g, active & near, it_count, 1);
+    active &= ~near;
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
+    }
+  }
+}
+
+#endif
+
+// picks the widest kernels the CPU supports, up to $DTEKV_KERNEL
+void choose_kernels(void) {
+  const char* cap = getenv("DTEKV_KERNEL");
+  if (cap != NULL && strcmp(cap, "scalar") == 0) {
+    return;
+  }
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  kernel_name = "sse2";
+  double_lanes = 2;
+  double_kernel = iterate_double_sse2;
+  if (cap != NULL && strcmp(cap, "sse2") == 0) {
+    return;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernel_name = "avx2";
+    double_lanes = 4;
+    double_kernel = iterate_double_avx2;
+    fixed_lanes = 4;
+    fixed_kernel = iterate_fixed_avx2;
+  }
+  if (cap != NULL && strcmp(cap, "avx2") == 0) {
+    return;
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    kernel_name = "avx512";
+    double_lanes = 8;
+    double_kernel = iterate_double_avx512;
+    fixed_lanes = 8;
+    fixed_kernel = iterate_fixed_avx512;
+  }
+#endif
+}
+
+// sets lane k of the group to pixel (i,j) of the view, returns 0 if it is culled instead
+static int fill_vector_lane(struct view* v, struct vector_group* g, int k, int i, int j) {
+  if (v->use_fixed) {
+    fixed x = fixed_cols[i];
+    fixed y = fixed_rows[j];
+    if (v->type == 'J') {
+      g->fu[k] = x;
+      g->fv[k] = y;
+      g->fcx[k] = v->fcx;
+      g->fcy[k] = v->fcy;
+      g->round[k] = 0;
+      return 1;
+    }
+    if (in_main_bulbs_fixed(x, y)) {
+      return 0;
+    }
+    g->fu[k] = 0;
+    g->fv[k] = 0;
+    g->fcx[k] = x;
+    g->fcy[k] = y;
+    g->round[k] = (1LL << (FIX_FRAC_BITS - 1)) - 1;
+    return 1;
+  }
+
+  double x = double_cols[i];
+  double y = double_rows[j];
+  if (v->type == 'J') {
+    g->u[k] = x;
+    g->v[k] = y;
+    g->cx[k] = v->cx;
+    g->cy[k] = v->cy;
+    return 1;
+  }
+  if (in_main_bulbs_double(x, y)) {
+    return 0;
+  }
+  g->u[k] = 0.0;
+  g->v[k] = 0.0;
+  g->cx[k] = x;
+  g->cy[k] = y;
+  return 1;
+}
+
+// pads lane k with an orbit that escapes before its first iteration
+static void pad_vector_lane(struct vector_group* g, int k) {
+  g->u[k] = 1e3;
+  g->v[k] = 0.0;
+  g->cx[k] = 0.0;
+  g->cy[k] = 0.0;
+  g->fu[k] = 3 * FIX_ONE;
+  g->fv[k] = 0;
+  g->fcx[k] = 0;
+  g->fcy[k] = 0;
+  g->round[k] = 0;
+}
+
+// iterates every unknown pixel of row j with the chosen vector kernel, returns 0 if it has none for the view
+int render_row_vector(struct view* v, int j) {
+  int lanes = v->use_fixed ? fixed_lanes : double_lanes;
+  if (lanes == 0 || v->deep != 0) {
+    return 0;
+  }
+
+  unsigned short* row = &it_buffer[(j - v->y0) * v->width];
+  struct vector_group g;
+  int next = 0;
+  while (next < v->width) {
+    g.count = 0;
+    for (; next < v->width && g.count < lanes; next++) {
+      if (row[next] != IT_UNKNOWN) {
+        continue;
+      }
+      if (!fill_vector_lane(v, &g, g.count, next, j)) {
+        stats.culled++;
+        store_pixel(v, next, j, v->max_it_count);
+        continue;
+      }
+      g.i[g.count] = next;
+      g.count++;
+    }
+    if (g.count == 0) {
+      break;
+    }
+    for (int k = g.count; k < lanes; k++) {
+      pad_vector_lane(&g, k);
+    }
+
+    if (v->use_fixed) {
+      fixed_kernel(&g, v->max_it_count);
+    } else {
+      double_kernel(&g, v->max_it_count, v->bailout);
+    }
+    for (int k = 0; k < g.count; k++) {
+      if (g.periodic[k]) {
+        count_periodic(g.it_count[k], v->max_it_count);
+        store_pixel(v, g.i[k], j, v->max_it_count);
+      } else {
+        stats.iterations += g.it_count[k];
+        store_pixel(v, g.i[k], j, g.it_count[k]);
+      }
+    }
+  }
+  return 1;
+}
+
+// returns the name of the kernel that iterates the brute force rows of the view
+const char* view_kernel(struct view* v, int mode) {
+  int lanes = v->use_fixed ? fixed_lanes : double_lanes;
+  return mode == MODE_BRUTE && lanes > 0 && v->deep == 0 ? kernel_name : "scalar";
+}
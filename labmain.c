@@ -1,14 +1,28 @@
+#include "hal.h"
+#include "config.h"
+#include "palette.h"
+#include "batch.h"
+#include "report.h"
+
 extern void print(const char*);
 extern void print_dec(unsigned int);
 extern void print_hex32(unsigned int);
 extern void printc(char);
+extern void console_poll(void);
+extern void console_flush(void);
 
-// memcpy if compiler flags -O0 requires it
-void *memcpy(void *dest, const void *src, unsigned n) {
-    for (unsigned i = 0; i < n; i++) {
-        ((char*)dest)[i] = ((char*)src)[i];
-    }
-}
+// number of switches, each selects one config entry
+#define NUM_SWITCHES 10
+
+// state of the render in progress, thread-local in render.host (host/render.c), which renders bands on several threads
+#ifndef RENDER_LOCAL
+#define RENDER_LOCAL
+#endif
+
+// renders row j of a brute force render and returns 1 where render.host has a vector kernel for it, never on the board
+#ifndef RENDER_ROW
+#define RENDER_ROW(v, j) 0
+#endif
 
 struct datakey {
   int* ptr;
@@ -20,31 +34,6 @@ struct complex {
   double imag;
 };
 
-struct mandelbrot {
-  char type;
-  double xmax;
-  double xmin;
-  double ymax;
-  double ymin;
-  int res;
-};
-
-struct julia {
-  char type;
-  double xmax;
-  double xmin;
-  double ymax;
-  double ymin;
-  double real;
-  double imag;
-  int res;
-};
-
-struct sierpinski {
-  char type;
-  int res;
-};
-
 /*
   Normally a program uses the heap to allocate memory for our configuration data and cached dictionaries.
   In DTEKV that is not possible, so the second best option is to use 'static'. However, there are issues 
@@ -57,23 +46,54 @@ struct sierpinski {
 
   If the program is already running and want to first download any given image (which requires us to step out)
   and then step back into the program to generate another image this would not be possible with 'static'.
-  Therefore, using relativly highly ordered memory addresses was the solution. 
+  Therefore, the data lives in regions at fixed addresses above the program, which survive dtekv-run.
 
-  The opted solution is not correct though. The issue with just using random memory addresses
-  is that the program may decide to use them for other purposes, in which memory segfaults and
-  other inconsistencies may occur. However, this was the ONLY solution given the limits of dtekv-run, 
-  dtekv-upload and dtekv-download (without modifying these commands).
+  The regions are defined with their sizes in regions.lds, which the linker script includes and
+  main.host links in too. The linker refuses to link a program whose stack runs into them, and
+  everything written to a region is checked against its end, so a region never spills into the
+  next one. The parsed config is kept in the arena region, see 'struct arena_header'.
 
   Should be mentioned it is also not possible to run dtekv-upload or dtekv-download
   if an instance is running the program in the terminal already. Although that seems to be a
   limitation of JTAGD itself.
 */
-char* cfg_ptr =                           (char*)               0x200000;
-struct mandelbrot* cfg_mandeldata =       (struct mandelbrot*)  0x210000;
-struct julia* cfg_juliadata =             (struct julia*)       0x220000;
-struct sierpinski* cfg_sierpinskidata =   (struct sierpinski*)  0x230000;
-struct datakey* cfg_datamap =             (struct datakey*)     0x240000;
-char* image_buffer =                      (char*)               0x250000;
+extern char __config_start[], __config_end[];
+extern char __arena_start[], __arena_end[];
+extern char __report_start[], __report_end[];
+extern char __image_start[], __image_end[];
+extern char __orbit_start[], __orbit_end[];
+extern char __image_cache_start[], __image_cache_end[];
+extern char __it_cache_start[], __it_cache_end[];
+extern char __bench_start[], __bench_end[];
+
+// the symbols only initialise these pointers, which keeps them absolute in the position independent main.host
+char* cfg_ptr =                           __config_start;
+struct arena_header* arena =              (struct arena_header*)  __arena_start;
+RENDER_LOCAL struct render_report* render_report = (struct render_report*) __report_start;
+char* image_buffer =                      __image_start;
+struct complex* reference_orbit =         (struct complex*)       __orbit_start;
+struct image_cache* image_cache =         (struct image_cache*)   __image_cache_start;
+unsigned short* it_cache_data =           (unsigned short*)       __it_cache_start;
+char* bench_buffer =                      __bench_start;
+
+// where each region ends, nothing is written at or past it
+char* cfg_end =                           __config_end;
+char* arena_end =                         __arena_end;
+char* report_end =                        __report_end;
+char* image_end =                         __image_end;
+char* orbit_end =                         __orbit_end;
+char* image_cache_end =                   __image_cache_end;
+char* it_cache_end =                      __it_cache_end;
+char* bench_end =                         __bench_end;
+
+// entries of the loaded config, allocated from the arena
+struct datakey* cfg_datamap = 0;
+
+// images are written from 'image_buffer' up to the reference orbit, about 28 MB
+#define IMAGE_BUFFER_SIZE (image_end - image_buffer)
+
+// the reference orbit holds this many iterations, 0 included
+#define REFERENCE_CAPACITY ((int) ((orbit_end - (char*) reference_orbit) / sizeof(struct complex)))
 
 double sqrt(double x) {
     if (x == 0) {
@@ -90,19 +110,47 @@ double sqrt(double x) {
     return guess;
 }
 
-void handle_interrupt(unsigned cause){}
+/*
+  Input.
+
+  The switches and the button raise interrupts, so the main loop sleeps
+  in 'hal_wait' until there is something to do. A button press is
+  latched in 'button_pressed'. A press while rendering also sets
+  'render_cancelled', which renders check at row and tile boundaries to
+  return early, and the main loop then renders the new selection. The
+  cancelled image is neither cached nor reported.
+*/
+volatile int input_pending = 0;
+volatile int button_pressed = 0;
+volatile int switches_changed = 0;
+volatile int rendering = 0;
+volatile int render_cancelled = 0;
+
+void handle_interrupt(unsigned cause) {
+  if (cause == HAL_IRQ_BUTTON) {
+    button_pressed = 1;
+    if (rendering) {
+      render_cancelled = 1;
+    }
+  } else if (cause == HAL_IRQ_SWITCHES) {
+    switches_changed = 1;
+  }
+  hal_ack_input(cause);
+  input_pending = 1;
+
+  // drains the console queue whenever we are interrupted anyway
+  console_poll();
+}
 
 // returns switch state by index [0,10)
 int get_sw(char index) {
-  volatile int *ptr = (volatile int*) 0x4000010;
-  
   //bit mask by index
-  return *ptr & (1 << index);
+  return hal_sw() & (1 << index);
 }
 
 // returns first enabled switch by index [0,10) in natural order
 int get_sw_i(void) {
-  for (int i = 0; i < 10; i++) {
+  for (int i = 0; i < NUM_SWITCHES; i++) {
     if (get_sw(i)) {
       return i;
     }
@@ -110,15 +158,10 @@ int get_sw_i(void) {
   return -1;
 }
 
-// returns 1 if button is pressed, else 0
-int get_btn(void) {
-  return *((volatile int*) 0x40000d0);
-}
-
 // returns fractal type by index from cache
 char fetch_type(int index) {
   char type = cfg_datamap[index].type;
-  if (type == 'M' || type == 'J' || type == 'S') {
+  if (type == 'M' || type == 'J' || type == 'S' || type == 'B') {
     return type;
   }
 
@@ -151,12 +194,48 @@ void println(const char* s) {
   printc('\n');
 }
 
+// returns n / d and stores n % d in rem, rv32 has no 64-bit division (softfloat.a does not provide __udivdi3)
+unsigned long long udiv64(unsigned long long n, unsigned int d, unsigned int* rem) {
+  unsigned long long q = 0;
+  unsigned long long r = 0;
+  for (int i = 63; i >= 0; i--) {
+    r = (r << 1) | ((n >> i) & 1);
+    if (r >= d) {
+      r -= d;
+      q |= 1ULL << i;
+    }
+  }
+  if (rem) {
+    *rem = (unsigned int) r;
+  }
+  return q;
+}
+
+// writes s in ascii decimal and returns the cursor past the last digit
+char* write_long(char* dst, unsigned long long s) {
+  char digits[20];
+  int n = 0;
+  do {
+    unsigned int digit;
+    s = udiv64(s, 10, &digit);
+    digits[n++] = '0' + digit;
+  } while (s != 0);
+
+  while (n > 0) {
+    *dst = digits[--n]; dst++;
+  }
+  return dst;
+}
+
 void print_long(unsigned long long s) {
-  unsigned int msb = (unsigned int) (s >> 32);
-  if (msb != 0) {
-    print_dec(msb);
+  if ((s >> 32) == 0) {
+    print_dec((unsigned int) s);
+    return;
   }
-  print_dec((unsigned int) 0xffffffff & s);
+
+  char digits[21];
+  *write_long(digits, s) = '\0';
+  print(digits);
 }
 
 void println_long(unsigned long long s) {
@@ -164,6 +243,13 @@ void println_long(unsigned long long s) {
   printc('\n');
 }
 
+// prints the resolution as 'widthxheight'
+void print_dims(int width, int height) {
+  print_dec(width);
+  printc('x');
+  print_dec(height);
+}
+
 void println_dec(unsigned int s) {
   print_dec(s);
   printc('\n');
@@ -207,558 +293,3040 @@ void println_double(double x) {
   printc('\n');
 }
 
-static unsigned int mcycleh = 0;
-static unsigned int mcycle = 0;
-static unsigned int minstreth = 0;
-static unsigned int minstret = 0;
-static unsigned int mhpmcounter3h= 0;
-static unsigned int mhpmcounter3 = 0;
-static unsigned int mhpmcounter4h= 0;
-static unsigned int mhpmcounter4 = 0;
-static unsigned int mhpmcounter5h= 0;
-static unsigned int mhpmcounter5 = 0;
-static unsigned int mhpmcounter6h= 0;
-static unsigned int mhpmcounter6 = 0;
-static unsigned int mhpmcounter7h= 0;
-static unsigned int mhpmcounter7 = 0;
-static unsigned int mhpmcounter8h= 0;
-static unsigned int mhpmcounter8 = 0;
-static unsigned int mhpmcounter9h= 0;
-static unsigned int mhpmcounter9 = 0;
+// counters as of the last call to read_counters
+unsigned long long last_counters[HAL_COUNTERS];
 
 void reset_counters() {
-  asm volatile ("csrw mcycleh, x0");
-  asm volatile ("csrw mcycle, x0");
-  asm volatile ("csrw minstreth, x0");
-  asm volatile ("csrw minstret, x0");
-  asm volatile ("csrw mhpmcounter3h, x0");
-  asm volatile ("csrw mhpmcounter3, x0");
-  asm volatile ("csrw mhpmcounter4h, x0");
-  asm volatile ("csrw mhpmcounter4, x0");
-  asm volatile ("csrw mhpmcounter5h, x0");
-  asm volatile ("csrw mhpmcounter5, x0");
-  asm volatile ("csrw mhpmcounter6h, x0");
-  asm volatile ("csrw mhpmcounter6, x0");
-  asm volatile ("csrw mhpmcounter7h, x0");
-  asm volatile ("csrw mhpmcounter7, x0");
-  asm volatile ("csrw mhpmcounter8h, x0");
-  asm volatile ("csrw mhpmcounter8, x0");
-  asm volatile ("csrw mhpmcounter9h, x0");
-  asm volatile ("csrw mhpmcounter9, x0");
+  hal_reset_counters();
 }
 
+// reads the counters into 'last_counters', they are printed with the report (see finish_report)
 void read_counters() {
+  hal_read_counters(last_counters);
+}
 
-  asm ("csrr %0, mcycleh" : "=r"(mcycleh));
-  asm ("csrr %0, mcycle" : "=r"(mcycle));
-  asm ("csrr %0, minstreth" : "=r"(minstreth));
-  asm ("csrr %0, minstret" : "=r"(minstret));
-  asm ("csrr %0, mhpmcounter3h" : "=r"(mhpmcounter3h));
-  asm ("csrr %0, mhpmcounter3" : "=r"(mhpmcounter3));
-  asm ("csrr %0, mhpmcounter4h" : "=r"(mhpmcounter4h));
-  asm ("csrr %0, mhpmcounter4" : "=r"(mhpmcounter4));
-  asm ("csrr %0, mhpmcounter5h" : "=r"(mhpmcounter5h));
-  asm ("csrr %0, mhpmcounter5" : "=r"(mhpmcounter5));
-  asm ("csrr %0, mhpmcounter6h" : "=r"(mhpmcounter6h));
-  asm ("csrr %0, mhpmcounter6" : "=r"(mhpmcounter6));
-  asm ("csrr %0, mhpmcounter7h" : "=r"(mhpmcounter7h));
-  asm ("csrr %0, mhpmcounter7" : "=r"(mhpmcounter7));
-  asm ("csrr %0, mhpmcounter8h" : "=r"(mhpmcounter8h));
-  asm ("csrr %0, mhpmcounter8" : "=r"(mhpmcounter8));
-  asm ("csrr %0, mhpmcounter9h" : "=r"(mhpmcounter9h));
-  asm ("csrr %0, mhpmcounter9" : "=r"(mhpmcounter9));
-  print("mcycle      =");
-  println_long((((unsigned long long)mcycleh) << 32) | mcycle);
-  print("minstret    =");
-  println_long((((unsigned long long)minstreth) << 32) | minstret);
-  print("mhpmcounter3=");
-  println_long((((unsigned long long)mhpmcounter3h) << 32) | mhpmcounter3);
-  print("mhpmcounter4=");
-  println_long((((unsigned long long)mhpmcounter4h) << 32) | mhpmcounter4);
-  print("mhpmcounter5=");
-  println_long((((unsigned long long)mhpmcounter5h) << 32) | mhpmcounter5);
-  print("mhpmcounter6=");
-  println_long((((unsigned long long)mhpmcounter6h) << 32) | mhpmcounter6);
-  print("mhpmcounter7=");
-  println_long((((unsigned long long)mhpmcounter7h) << 32) | mhpmcounter7);
-  print("mhpmcounter8=");
-  println_long((((unsigned long long)mhpmcounter8h) << 32) | mhpmcounter8);
-  print("mhpmcounter9=");
-  println_long((((unsigned long long)mhpmcounter9h) << 32) | mhpmcounter9);
-}
-
-// parses next signed int number in ascii, also moves the cursor to the terminating character of the token
-signed int parse_int(char** ptr) {
-  char* str = *ptr;
-  signed int sign = 1;
-  signed int val = 0;
-
-  //support negative
-  if (*str == '-') {
-    sign = -1;
-    str++;
-  }
-
-  while ('0' <= *str && *str <= '9') {
-    val = val * 10 + (*str - '0');
-    str++;
-  }
-
-  *ptr = str;
-  return sign * val;
-}
-
-// parses next signed double number in ascii, also moves the cursor to the terminating character of the token
-double parse_double(char** ptr) {
-  char* str = *ptr;
-  double val = 0.0;
-  int sign = 1;
-
-  //decimals
-  int d_seen = 0;
-  int d_index = 0;
-
-  //support negative
-  if (*str == '-') {
-    sign = -1;
-    str++;
-  }
-
-  while (*str != ';') {
-    char c = *str;
-
-    if (c >= '0' && c <= '9') {
-      val = val * 10 + (c - '0');
-      if (d_seen) {
-        d_index++;
-      }
-    } else if (c == '.' && !d_seen) {
-      d_seen = 1;
-    } else {
-      *ptr = str;
-      return 0;
-    }
+/*
+  Progress reporting.
+
+  Progress is printed in whole percent, at most once every 'progress_step'
+  percent (set with 'P;<percent>;' in the config, 0 disables it). Printing
+  only queues bytes, see console_poll, so it is cheap enough to call at
+  every row or tile boundary.
+*/
+int progress_next = 0;
 
-    str++;
+void begin_progress() {
+  progress_next = 0;
+}
+
+void print_progress(int done, int total) {
+  console_poll();
+  if (progress_step <= 0) {
+    return;
   }
 
-  if (d_index > 0) {
-    for (int i = 0; i < d_index; i++) {
-      val /= 10;
-    }
+  int percent = (done * 100) / total;
+  if (percent < progress_next) {
+    return;
   }
+  progress_next = percent - percent % progress_step + progress_step;
 
-  *ptr = str;
-  return val*sign;
+  printc('\r');
+  print_dec(percent);
+  printlnc('%');
 }
 
-// parses next mandelbrot struct in ascii, also moves the cursor to the terminating character of the token
-struct mandelbrot parse_mandelbrot(char** ptr) {
-  double xmax = parse_double(ptr);
-  (*ptr)++;
-  double xmin = parse_double(ptr);
-  (*ptr)++;
-  double ymax = parse_double(ptr);
-  (*ptr)++;
-  double ymin = parse_double(ptr);
-  (*ptr)++;
-  int res = parse_int(ptr);
-  (*ptr)++;
-  struct mandelbrot data = {
-    'M',
-    xmax,
-    xmin,
-    ymax,
-    ymin,
-    res
-  };
-  return data;
+// FNV-1a
+unsigned int hash_bytes(unsigned int hash, void* data, int size) {
+  unsigned char* bytes = data;
+  for (int k = 0; k < size; k++) {
+    hash = (hash ^ bytes[k]) * 16777619;
+  }
+  return hash;
 }
 
-// parses next julia struct in ascii, also moves the cursor to the terminating character of the token
-struct julia parse_julia(char** ptr) {
-  double xmax = parse_double(ptr);
-  (*ptr)++;
-  double xmin = parse_double(ptr);
-  (*ptr)++;
-  double ymax = parse_double(ptr);
-  (*ptr)++;
-  double ymin = parse_double(ptr);
-  (*ptr)++;
-  double real = parse_double(ptr);
-  (*ptr)++;
-  double imag = parse_double(ptr);
-  (*ptr)++;
-  int res = parse_int(ptr);
-  (*ptr)++;
-  struct julia data = {
-    'J',
-    xmax,
-    xmin,
-    ymax,
-    ymin,
-    real,
-    imag,
-    res
-  };
-  return data;
+// Fletcher style checksum, 'data' must be word aligned
+unsigned int checksum_bytes(void* data, int size) {
+  unsigned int* words = data;
+  unsigned int sum = 0;
+  unsigned int sum2 = 0;
+  int k;
+  for (k = 0; k < size / 4; k++) {
+    sum += words[k];
+    sum2 += sum;
+  }
+  unsigned char* tail = (unsigned char*) &words[k];
+  for (k = 0; k < size % 4; k++) {
+    sum += tail[k];
+    sum2 += sum;
+  }
+  return sum ^ (sum2 << 16 | sum2 >> 16);
 }
 
+// returns a hash of the date and time this program was compiled
+unsigned int build_hash() {
+  char build[] = __DATE__ " " __TIME__;
+  return hash_bytes(2166136261u, build, sizeof build);
+}
 
-// parses next mandelbrot struct in ascii, also moves the cursor to the terminating character of the token
-struct sierpinski parse_sierpinski(char** ptr) {
-  int res = parse_int(ptr);
-  (*ptr)++;
-  struct sierpinski data = {
-    'S',
-    res
-  };
-  return data;
+// largest number of config entries, only the first NUM_SWITCHES can be selected with the switches
+#define MAX_ENTRIES 512
+
+// number of entries in the loaded config
+int num_entries = 0;
+
+/*
+  Config arena.
+
+  The loaded config lives in the arena region: this header, the datamap
+  and the entries of a text config, each allocated at its own size. The
+  arena survives dtekv-run like the images do, so on start a text config
+  with the same hash as the one the arena was filled from, by this very
+  build, is used as is without parsing it again. A binary config needs
+  no parsing and only has its datamap here.
+*/
+#define ARENA_MAGIC 0x414b5444 // "DTKA"
+#define ARENA_VERSION 1
+
+struct arena_header {
+  unsigned int magic; // only set once the arena holds a whole parsed config
+  int version; // ARENA_VERSION, of the layout
+  unsigned int build;
+  unsigned int config; // config_hash() of the text it was parsed from
+  int used; // bytes allocated, the header included
+  int count; // entries in 'datamap'
+  int progress_step;
+  struct datakey* datamap;
+  unsigned int checksum; // of all fields above and the bytes allocated
+};
+
+#define ARENA_SIZE (arena_end - (char*) arena)
+
+// rounds up to 8 bytes, the alignment of a double
+int align8(int size) {
+  return (size + 7) & ~7;
+}
+
+unsigned int arena_checksum() {
+  int head = align8(sizeof(struct arena_header));
+  return checksum_bytes(arena, (char*) &arena->checksum - (char*) arena)
+    ^ checksum_bytes((char*) arena + head, arena->used - head);
+}
+
+// hashes the config text up to its end or the end of its region
+unsigned int config_hash(char* str) {
+  int length = 0;
+  while (str + length < cfg_end && str[length] != '\0') {
+    length++;
+  }
+  return hash_bytes(2166136261u, str, length);
+}
+
+// empties the arena, it is not reused until 'seal_arena'
+void reset_arena() {
+  arena->magic = 0;
+  arena->used = align8(sizeof(struct arena_header));
+  arena->count = 0;
+  arena->datamap = 0;
+}
+
+// returns 'size' bytes of the arena, or 0 if it is full
+void* arena_alloc(int size) {
+  if (size > ARENA_SIZE - arena->used) {
+    return 0;
+  }
+  void* p = (char*) arena + arena->used;
+  arena->used += align8(size);
+  return p;
+}
+
+// marks the arena as holding the config text of the given hash
+void seal_arena(unsigned int config) {
+  arena->version = ARENA_VERSION;
+  arena->build = build_hash();
+  arena->config = config;
+  arena->count = num_entries;
+  arena->progress_step = progress_step;
+  arena->datamap = cfg_datamap;
+  arena->magic = ARENA_MAGIC;
+  arena->checksum = arena_checksum();
+}
+
+// returns 1 if the arena holds the config text of the given hash, parsed by this very build
+int arena_valid(unsigned int config) {
+  if (arena->magic != ARENA_MAGIC || arena->version != ARENA_VERSION || arena->build != build_hash()
+      || arena->config != config || arena->used < align8(sizeof(struct arena_header)) || arena->used > ARENA_SIZE
+      || arena->count < 0 || arena->count > MAX_ENTRIES) {
+    return 0;
+  }
+  return arena->checksum == arena_checksum();
+}
+
+// allocates the datamap with every entry empty, 'check_regions' makes sure it fits
+void alloc_datamap() {
+  cfg_datamap = arena_alloc(MAX_ENTRIES * sizeof(struct datakey));
+  for (int i = 0; i < MAX_ENTRIES; i++) {
+    struct datakey empty = {0, '-'};
+    cfg_datamap[i] = empty;
+  }
+}
+
+// uses a binary config compiled by cfgc.host where it lies, returns 0 if it is not one
+int load_binary_cfg(char* str) {
+  struct cfg_header* header = (struct cfg_header*) str;
+  if (header->magic != CFG_MAGIC) {
+    return 0;
+  }
+  if (header->version != CFG_VERSION || header->entry_size != sizeof(union cfg_entry)
+      || header->count < 0 || header->count > MAX_ENTRIES) {
+    println("[SEVERE] Binary config was compiled by a different version of cfgc.host, recompile it!");
+    return 1;
+  }
+
+  union cfg_entry* entries = (union cfg_entry*) (header + 1);
+  if ((char*) &entries[header->count] > cfg_end) {
+    println("[SEVERE] Binary config is larger than the config region!");
+    return 1;
+  }
+  for (int i = 0; i < header->count; i++) {
+    struct datakey key = {
+      (int*) &entries[i],
+      entries[i].type
+    };
+    cfg_datamap[i] = key;
+  }
+  num_entries = header->count;
+  progress_step = header->progress_step;
+  return 1;
 }
 
-// reads configuration in ascii from the given pointer
+// reads configuration, compiled or in ascii, from the given pointer
 void load_cfg(char* str) {
-  int mandel_i = 0;
-  int julia_i = 0;
-  int sierpinski_i = 0;
-  int datamap_i = 0;
-  while (1) {
-    char c0 = *str;
-    str++;
-    char c1 = *str;
-    if (c1 == ';') {
-      str++;
-      if (c0 == 'M') {
-        struct mandelbrot data = parse_mandelbrot(&str);
-        cfg_mandeldata[mandel_i] = data;
-        struct datakey key = {
-          (struct mandelbrot*) &cfg_mandeldata[mandel_i],
-          'M'
-        };
-        cfg_datamap[datamap_i] = key;
-
-        datamap_i++;
-        mandel_i++;
-      } else if (c0 == 'J') {
-        struct julia data = parse_julia(&str);
-        cfg_juliadata[julia_i] = data;
-        struct datakey key = {
-          (struct julia*) &cfg_juliadata[julia_i],
-          'J'
-        };
-        cfg_datamap[datamap_i] = key;
-
-        datamap_i++;
-        julia_i++;
-      } else if (c0 == 'S') {
-        struct sierpinski data = parse_sierpinski(&str);
-        cfg_sierpinskidata[sierpinski_i] = data;
-        struct datakey key = {
-          (struct sierpinski*) &cfg_sierpinskidata[sierpinski_i],
-          'S'
-        };
-        cfg_datamap[datamap_i] = key;
-
-        datamap_i++;
-        sierpinski_i++;
-      }
+  unsigned int config = config_hash(str);
+  if (arena_valid(config)) {
+    cfg_datamap = arena->datamap;
+    num_entries = arena->count;
+    progress_step = arena->progress_step;
+    print("[INFO] Config unchanged since the last run, reusing its '");
+    print_dec(num_entries);
+    println("' entries");
+    return;
+  }
 
-    } else if (c0 == '\0' || c0 == '#') {
+  // forget entries of a previously uploaded config
+  reset_arena();
+  alloc_datamap();
+  num_entries = 0;
+
+  if (load_binary_cfg(str)) {
+    return;
+  }
+
+  struct cfg_parser parser;
+  begin_cfg(&parser, str);
+  union cfg_entry entry;
+  char type;
+  while ((type = parse_entry(&parser, &entry)) != 0) {
+    if (num_entries == MAX_ENTRIES) {
+      print("[WARNING] Ignoring entries past the first ");
+      print_dec(MAX_ENTRIES);
+      printlnc('!');
       break;
     }
+
+    int size = 0;
+    if (type == 'M') {
+      size = sizeof(struct mandelbrot);
+    } else if (type == 'J') {
+      size = sizeof(struct julia);
+    } else if (type == 'S') {
+      size = sizeof(struct sierpinski);
+    }
+    struct datakey key = {0, type};
+    if (size > 0) {
+      key.ptr = arena_alloc(size);
+      if (key.ptr == 0) {
+        print("[WARNING] No room for more entries, ignoring those past the first ");
+        print_dec(num_entries);
+        printlnc('!');
+        break;
+      }
+    }
+    if (type == 'M') {
+      *(struct mandelbrot*) key.ptr = entry.mandelbrot;
+    } else if (type == 'J') {
+      *(struct julia*) key.ptr = entry.julia;
+    } else if (type == 'S') {
+      *(struct sierpinski*) key.ptr = entry.sierpinski;
+    }
+    cfg_datamap[num_entries] = key;
+    num_entries++;
+  }
+
+  if (parser.errors > 0) {
+    print("[WARNING] Config has '");
+    print_dec(parser.errors);
+    println("' malformed entries, their switches do nothing");
   }
+  seal_arena(config);
 }
 
-// writes small header (64x64) in PPM format (P6), will always be plain
-void write_small_header(char** dst) {
+// writes the header of a binary PPM (P6) image of the given size, with 8 bits per channel
+void write_ppm_header(char** dst, int width, int height) {
   char* ptr = *dst;
   *ptr = 'P'; ptr++; *ptr = '6'; ptr++;
   *ptr = '\n'; ptr++;
-  *ptr = '6'; ptr++; *ptr = '4'; ptr++;
+  ptr = write_long(ptr, width);
   *ptr = '\n'; ptr++;
-  *ptr = '6'; ptr++; *ptr = '4'; ptr++;
+  ptr = write_long(ptr, height);
   *ptr = '\n'; ptr++;
   *ptr = '2'; ptr++; *ptr = '5'; ptr++; *ptr = '5'; ptr++;
   *ptr = '\n'; ptr++;
   *dst = ptr;
-} 
+}
 
-// writes medium header (128x128) in PPM format (P6), will always be plain
-void write_medium_header(char** dst) {
+// writes the header of a binary PGM (P5) image of the given size, with a '# dtekv <type> <max_it_count>' comment for host/expand.c
+void write_pgm_header(char** dst, int width, int height, int maxval, char type, int max_it_count) {
   char* ptr = *dst;
-  *ptr = 'P'; ptr++; *ptr = '6'; ptr++;
-  *ptr = '\n'; ptr++; 
-  *ptr = '1'; ptr++; *ptr = '2'; ptr++; *ptr = '8'; ptr++;
+  *ptr = 'P'; ptr++; *ptr = '5'; ptr++;
+  *ptr = '\n'; ptr++;
+  char* comment = "# dtekv ";
+  while (*comment != '\0') {
+    *ptr = *comment; ptr++; comment++;
+  }
+  *ptr = type; ptr++; *ptr = ' '; ptr++;
+  ptr = write_long(ptr, max_it_count);
   *ptr = '\n'; ptr++;
-  *ptr = '1'; ptr++; *ptr = '2'; ptr++; *ptr = '8'; ptr++;
+  ptr = write_long(ptr, width);
   *ptr = '\n'; ptr++;
-  *ptr = '2'; ptr++; *ptr = '5'; ptr++; *ptr = '5'; ptr++;
+  ptr = write_long(ptr, height);
+  *ptr = '\n'; ptr++;
+  ptr = write_long(ptr, maxval);
   *ptr = '\n'; ptr++;
   *dst = ptr;
 }
 
-// writes large header (256x256) in PPM format (P6), will always be plain
-void write_large_header(char** dst) {
+// writes the header of a QOI image of the given size, with 3 channels in sRGB
+void write_qoi_header(char** dst, int width, int height) {
   char* ptr = *dst;
-  *ptr = 'P'; ptr++; *ptr = '6'; ptr++;
-  *ptr = '\n'; ptr++;
-  *ptr = '2'; ptr++; *ptr = '5'; ptr++; *ptr = '6'; ptr++;
-  *ptr = '\n'; ptr++;
-  *ptr = '2'; ptr++; *ptr = '5'; ptr++; *ptr = '6'; ptr++;
-  *ptr = '\n'; ptr++;
-  *ptr = '2'; ptr++; *ptr = '5'; ptr++; *ptr = '5'; ptr++;
-  *ptr = '\n'; ptr++;
+  *ptr = 'q'; ptr++; *ptr = 'o'; ptr++; *ptr = 'i'; ptr++; *ptr = 'f'; ptr++;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    *ptr = width >> shift; ptr++;
+  }
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    *ptr = height >> shift; ptr++;
+  }
+  *ptr = 3; ptr++;
+  *ptr = 0; ptr++;
   *dst = ptr;
 }
 
 /*
-  Writes mandelbrot data.
+  Statistics of the most recent render.
 
-  Mandelbrot sets are defined as z_n = z_n-1 + c,
-  where z_0 = 0+0i and c is the given (x,y) pixel,
-  where we use y to represnet the imaginary axis
-  and we use x to represent the real axis.
-  
-  We then iterate up to z_255, if the value
-  converges (that is if it cycles around), then we
-  paint it black, else we paint it some other color
-  depending on how quickly it diverges (that is if it
-  approaches infinity).
+  Filled by the write functions and printed once the
+  image is done, reset at the start of every render.
 */
-int write_mandelbrot_data(struct mandelbrot data, char* dst, int* size) {
-  reset_counters();
-  int sz = (int) dst;
-  if (data.res == 64) {
-    write_small_header(&dst);
-  } else if (data.res == 128) {
-    write_medium_header(&dst);
-  } else if (data.res == 256) {
-    write_large_header(&dst);
-  } else {
-    print("[SEVERE] Bad resolution '");
-    print_dec(data.res);
-    println("', only resolutions 64, 128 and 256 are allowed!");
-    return 0;
-  }
-  print("[INFO] Writing Mandelbrot with resolution '");
-  print_dec(data.res);
-  printlnc('\'');
+struct render_stats {
+  int pixels;
+  char kernel; // 'Q' for Q4.28, 'D' for double
+  unsigned long long iterations;
+  unsigned long long period_saved;
+  int culled;
+  int periodic;
+  int filled;
+  int reused;
+  int mirrored;
+  int rebased;
+};
 
-  // how many times we check if a value converges or diverges
-  const int max_it_count = 256;
+RENDER_LOCAL struct render_stats stats;
 
-  double xmax = data.xmax;
-  double xmin = data.xmin;
-  double ymax = data.ymax;
-  double ymin = data.ymin;
-  int res = data.res;
+/*
+  Render report, see report.h.
 
-  // dx and dy
-  double step_x = (xmax-xmin)/res;
-  double step_y = (ymax-ymin)/res;
+  Filled alongside the statistics: 'begin_image' records the view of
+  every image, 'tally_rows' adds the escape counts of rendered rows to
+  the histogram and 'note_rows' keeps the most expensive rows. The rest
+  is copied from the statistics and counters once the image is done.
+*/
+void reset_report() {
+  struct render_report* r = render_report;
+  r->magic = REPORT_MAGIC;
+  r->version = REPORT_VERSION;
+  r->size = sizeof(struct render_report);
+  r->index = -1;
+  r->type = '-';
+  r->kernel = '-';
+  r->mode = MODE_BRUTE;
+  r->width = 0;
+  r->height = 0;
+  r->max_it = 0;
+  r->interior = 0;
+  r->escaped = 0;
+  r->frames = 0;
+  r->bucket_width = 0;
+  for (int b = 0; b < REPORT_BUCKETS; b++) {
+    r->histogram[b] = 0;
+  }
+  for (int k = 0; k < REPORT_ROWS; k++) {
+    r->rows[k].y = 0;
+    r->rows[k].rows = 0;
+    r->rows[k].iterations = 0;
+  }
+}
 
-  // cached stack variables
-  int it_count;
-  int i, j;
-  double x, y;  
-  double u, v, u2, v2;
-  
-  for (j = 0; j < res; j++) {
-    //calculate y-coord value
-    y = ymax - (j * step_y);
+// keeps the span of rows starting at row y if it is among the REPORT_ROWS most expensive so far
+void note_rows(int y, int rows, unsigned long long iterations) {
+  struct report_rows* top = render_report->rows;
+  int k = REPORT_ROWS;
+  while (k > 0 && (top[k - 1].rows == 0 || top[k - 1].iterations < iterations)) {
+    k--;
+  }
+  if (k == REPORT_ROWS) {
+    return;
+  }
+  for (int m = REPORT_ROWS - 1; m > k; m--) {
+    top[m] = top[m - 1];
+  }
+  top[k].y = y;
+  top[k].rows = rows;
+  top[k].iterations = iterations;
+}
 
-    //print new progress
-    printc('\r');
-    print_double(((double)j*100)/res);
-    printlnc('%');
-
-
-    for(i = 0; i < res; i++) {
-    //calculate x-coord value
-      x = xmin + i * step_x;
-
-      u = 0.0;
-      v = 0.0;
-      u2 = 0;
-      v2 = 0;
-
-      //inspiration from https://en.wikipedia.org/wiki/Plotting_algorithms_for_the_Mandelbrot_set#Optimized_escape_time_algorithms
-      for (it_count = 1; max_it_count > it_count && (u2 + v2 < 4.0); it_count++) {
-        v = 2 * u * v + y;
-        u = u2 - v2 + x;
-        u2 = u * u;
-        v2 = v * v;
-      }
+// prints the least escape count that 'percent' percent of the escaped pixels escaped within
+void print_escape_percentile(int percent) {
+  struct render_report* r = render_report;
+  int seen = 0;
+  for (int b = 0; b < REPORT_BUCKETS; b++) {
+    seen += r->histogram[b];
+    if (100LL * seen >= (long long) percent * r->escaped) {
+      print_dec(percent);
+      print("% <= ");
+      print_dec((b + 1) * r->bucket_width);
+      return;
+    }
+  }
+}
 
-      //paint black if value does not diverge
-      if (max_it_count <= it_count) {
-        *dst = 0; dst++;
-        *dst = 0; dst++;
-        *dst = 0; dst++;
-      }
-      //paint some other color if value diverges
-      //we can use 'it_count' to represent how quickly said value diverges
-      else {
-        *dst = (it_count >> 2) % 256; dst++;
-        *dst = it_count % 256; dst++;
-        *dst = (it_count + 10) % 256; dst++;
+// completes the report from the statistics and counters and prints it in compact form
+void finish_report() {
+  static const char* names[HAL_COUNTERS] = {
+    "cycles", "instret", "mem", "icache_miss", "dcache_miss", "icache_stall", "dcache_stall", "hazard_stall", "alu_stall"
+  };
+  struct render_report* r = render_report;
+  r->kernel = stats.kernel;
+  r->iterations = stats.iterations;
+  r->period_saved = stats.period_saved;
+  for (int i = 0; i < HAL_COUNTERS; i++) {
+    r->counters[i] = last_counters[i];
+  }
+  r->pixels = r->frames * r->width * r->height;
+  r->culled = stats.culled;
+  r->periodic = stats.periodic;
+  r->filled = stats.filled;
+  r->reused = stats.reused;
+  r->mirrored = stats.mirrored;
+
+  print("[REPORT] ");
+  printc(r->type);
+  printc(' ');
+  print_dims(r->width, r->height);
+  if (r->frames > 1) {
+    printc('x');
+    print_dec(r->frames);
+  }
+  printc(' ');
+  printc(r->kernel);
+  print(r->mode == MODE_MARIANI_SILVER ? " ms" : " brute");
+  print(" it=");
+  print_dec(r->max_it);
+  print(": interior=");
+  print_dec(r->interior);
+  print(" escaped=");
+  print_dec(r->escaped);
+  print(" it/px=");
+  println_long(udiv64(r->iterations, r->pixels > 0 ? r->pixels : 1, 0));
+  print("[REPORT]");
+  for (int i = 0; i < HAL_COUNTERS; i++) {
+    printc(' ');
+    print(names[i]);
+    printc('=');
+    print_long(r->counters[i]);
+  }
+  printc('\n');
+  if (r->escaped > 0) {
+    print("[REPORT] escaped within: ");
+    print_escape_percentile(50);
+    print(", ");
+    print_escape_percentile(90);
+    print(", ");
+    print_escape_percentile(99);
+    println(" iterations");
+  }
+  if (r->rows[0].rows > 0) {
+    print("[REPORT] costliest rows:");
+    for (int k = 0; k < REPORT_ROWS && r->rows[k].rows > 0; k++) {
+      printc(' ');
+      print_dec(r->rows[k].y);
+      if (r->rows[k].rows > 1) {
+        printc('+');
+        print_dec(r->rows[k].rows);
       }
+      printc('=');
+      print_long(r->rows[k].iterations);
     }
+    printc('\n');
   }
+  print("[REPORT] Full report at '");
+  print_hex32((int) r);
+  print("' with size of '");
+  print_hex32(r->size);
+  println("'-bytes, print it with report.host");
+}
 
-  *size = (int) dst - sz;
-  read_counters();
-  return 1;
+void reset_render_stats() {
+  stats.pixels = 0;
+  stats.kernel = '-';
+  stats.iterations = 0;
+  stats.period_saved = 0;
+  stats.culled = 0;
+  stats.periodic = 0;
+  stats.filled = 0;
+  stats.reused = 0;
+  stats.mirrored = 0;
+  stats.rebased = 0;
+  reset_report();
 }
 
-/*
-  Writes julia data.
+void print_render_stats() {
+  print("[INFO] Iterations: ");
+  println_long(stats.iterations);
+  if (stats.periodic > 0) {
+    print("[INFO] Periodicity check stopped '");
+    print_dec(stats.periodic);
+    print("' pixels early, saving ");
+    print_long(stats.period_saved);
+    println(" iterations");
+  }
+  if (stats.culled > 0) {
+    print("[INFO] Culled '");
+    print_dec(stats.culled);
+    println("' interior pixels (main cardioid and period-2 bulb)");
+  }
+  if (stats.filled > 0) {
+    print("[INFO] Filled '");
+    print_dec(stats.filled);
+    println("' pixels without iterating (Mariani-Silver)");
+  }
+  if (stats.reused > 0) {
+    print("[INFO] Reused '");
+    print_dec(stats.reused);
+    println("' pixels from the render cache");
+  }
+  if (stats.mirrored > 0) {
+    print("[INFO] Mirrored '");
+    print_dec(stats.mirrored);
+    println("' pixels by symmetry");
+  }
+  if (stats.rebased > 0) {
+    print("[INFO] Rebased '");
+    print_dec(stats.rebased);
+    println("' orbits onto the start of the reference (perturbation)");
+  }
+  finish_report();
+}
 
-  Julia sets are defined as z_n = z_n-1 + c,
-  where z_0 = (x,y) of the given (x,y) pixel,
-  where we use y to represnet the imaginary axis
-  and we use x to represent the real axis. Then c 
-  is just some starting number c = a + bi.
-  
-  We then iterate up to z_255 and here we paint
-  the pixel differently depending on how quickly
-  it increases and eventually diverges or is cyclic.
+/*
+  Periodicity checking.
+
+  Orbits of interior points end up in a cycle and would otherwise run all
+  'max_it_count' iterations. Like Brent's cycle detection we keep a saved
+  orbit point, which is moved forward every time the number of iterations
+  since the last save reaches a power of two, and compare every new point
+  against it. Once the orbit returns to the saved point it has become
+  periodic and will never escape.
+
+  The iteration is deterministic, so an exact repeat is proof of a cycle.
+  A few ulps of tolerance lets attracting cycles be caught before rounding
+  has settled on an exact repeat, which is far below anything that could
+  still escape within 'max_it_count' iterations.
 */
-int write_julia_data(struct julia data, char* dst, int* size) {
-  int sz = (int) dst;
-  if (data.res == 64) {
-    write_small_header(&dst);
-  } else if (data.res == 128) {
-    write_medium_header(&dst);
-  } else if (data.res == 256) {
-    write_large_header(&dst);
-  } else {
-    print("[SEVERE] Bad resolution '");
-    print_dec(data.res);
-    println("', only resolutions 64, 128 and 256 are allowed!");
-    return 0;
-  }
-  print("[INFO] Writing Julia with resolution '");
-  print_dec(data.res);
-  printlnc('\'');
 
-  // how many times we check if a value converges or diverges
-  const int max_it_count = 256;
+// tolerance in Q4.28 ulps when comparing against the saved orbit point
+#define FIX_PERIOD_EPS 4
+
+// tolerance in ulps of the double representation when comparing against the saved orbit point
+#define DOUBLE_PERIOD_EPS 16
 
-  double xmax = data.xmax;
-  double xmin = data.xmin;
-  double ymax = data.ymax;
-  double ymin = data.ymin;
-  int res = data.res;
+// iterations before the saved orbit point is first moved
+#define PERIOD_START 8
+
+// returns 1 if a and b are within FIX_PERIOD_EPS ulps
+int near_fixed(fixed a, fixed b) {
+  fixed d = a - b;
+  return d <= FIX_PERIOD_EPS && d >= -FIX_PERIOD_EPS;
+}
 
-  // dx and dy
-  double step_x = (xmax-xmin)/res;
-  double step_y = (ymax-ymin)/res;
+// returns 1 if a and b are within DOUBLE_PERIOD_EPS ulps, compares the bit patterns so no softfloat is involved
+int near_double(double a, double b) {
+  union { double d; unsigned long long bits; } pa, pb;
+  pa.d = a;
+  pb.d = b;
+  // unsigned, so patterns of opposite sign wrap around instead of overflowing
+  unsigned long long d = pa.bits - pb.bits;
+  return d + DOUBLE_PERIOD_EPS <= 2 * DOUBLE_PERIOD_EPS;
+}
 
-  double cx = data.real;
-  double cy = data.imag;
+// records a pixel whose orbit was found periodic after 'it_count' iterations
+void count_periodic(int it_count, int max_it_count) {
+  stats.iterations += it_count;
+  stats.period_saved += max_it_count - 1 - it_count;
+  stats.periodic++;
+}
 
-  // cached stack variables
+// returns escape iteration count of c = x + iy for the mandelbrot set, using Q4.28
+int mandelbrot_it_fixed(fixed x, fixed y, int max_it_count) {
+  fixed u = 0;
+  fixed v = 0;
+  long long u2 = 0;
+  long long v2 = 0;
   int it_count;
-  int i, j;
-  double x, y;  
-  double u, v, u2, v2;
-  
-  for (j = 0; j < res; j++) {
-    //calculate y-coord value
-    y = ymax - (j * step_y);
 
-    //print new progress
-    printc('\r');
-    print_double(((double)j*100)/res);
-    printlnc('%');
+  fixed pu = 0;
+  fixed pv = 0;
+  int period = 0;
+  int period_len = PERIOD_START;
+
+  for (it_count = 1; max_it_count > it_count && (u2 + v2 < FIX_BAILOUT); it_count++) {
+    // 2uv rounds towards zero, which keeps c and conj(c) bit-identical
+    long long uv = (long long) u * v;
+    uv += (uv >> 63) & ((1LL << (FIX_FRAC_BITS - 1)) - 1);
+    v = (fixed) (uv >> (FIX_FRAC_BITS - 1)) + y;
+    u = (fixed) ((u2 - v2) >> FIX_FRAC_BITS) + x;
+    u2 = (long long) u * u;
+    v2 = (long long) v * v;
+
+    if (near_fixed(u, pu) && near_fixed(v, pv) && u2 + v2 < FIX_BAILOUT) {
+      count_periodic(it_count, max_it_count);
+      return max_it_count;
+    }
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
+    }
+  }
 
+  stats.iterations += it_count;
+  return it_count;
+}
 
-    for(i = 0; i < res; i++) {
-    //calculate x-coord value
-      x = xmin + i * step_x;
+// returns escape iteration count of z_0 = x + iy for the julia set of c = cx + i*cy, using Q4.28
+int julia_it_fixed(fixed x, fixed y, fixed cx, fixed cy, int max_it_count) {
+  fixed u = x;
+  fixed v = y;
+  long long u2 = (long long) u * u;
+  long long v2 = (long long) v * v;
+  int it_count;
 
-      u = x;
-      v = y;
-      u2 = u*u;
-      v2 = v*v;
+  fixed pu = u;
+  fixed pv = v;
+  int period = 0;
+  int period_len = PERIOD_START;
 
-      for (it_count = 1; max_it_count > it_count && (u2 + v2 < 4.0); it_count++) {
-        v = 2*u*v + cy;
-        u = u2 - v2 + cx;
-        v2 = v * v;
-        u2 = u * u;
-      }
+  for (it_count = 1; max_it_count > it_count && (u2 + v2 < FIX_BAILOUT); it_count++) {
+    v = (fixed) (((long long) u * v) >> (FIX_FRAC_BITS - 1)) + cy;
+    u = (fixed) ((u2 - v2) >> FIX_FRAC_BITS) + cx;
+    v2 = (long long) v * v;
+    u2 = (long long) u * u;
 
-      *dst = 255 - (it_count % 256); dst++;
-      *dst = 255 - (it_count*2 % 256); dst++;
-      *dst = 255 - (it_count*4 % 256); dst++;
+    if (near_fixed(u, pu) && near_fixed(v, pv) && u2 + v2 < FIX_BAILOUT) {
+      count_periodic(it_count, max_it_count);
+      return max_it_count;
+    }
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
     }
   }
 
-  *size = (int) dst - sz;
-  return 1;
+  stats.iterations += it_count;
+  return it_count;
 }
 
+// returns escape iteration count of c = x + iy for the mandelbrot set, escaping at |z|^2 >= bailout, using softfloat doubles
+int mandelbrot_it_double(double x, double y, int max_it_count, double bailout) {
+  double u = 0.0;
+  double v = 0.0;
+  double u2 = 0;
+  double v2 = 0;
+  int it_count;
 
-int write_sierpinski_data(struct sierpinski data, char* dst, int* size) {
-  println("[ERROR] Sierpinski is not yet implemented");
-  return 0;
-}
-
-int process_image(int index, char* dst, int* size) {
-  char type = fetch_type(index);
-  if (type == '-') {
-    print("[WARNING] Cannot process due to bad type at switch '");
-    print_dec(index);
-    printc('\'');
-    println(", this could be due to an incorrect type or missing.");
-    return 0;
-  } else if (type == 'M') {
-    return write_mandelbrot_data(fetch_mandelbrot(index), dst, size);
-  } else if (type == 'J') {
-    return write_julia_data(fetch_julia(index), dst, size);
-  } else if (type == 'S') {
-    return write_sierpinski_data(fetch_sierpinski(index), dst, size);
-  }else {
-    //should never happen since we cover all cases already
-    println("[ERROR] How did we get here?");
-    return 0;
+  double pu = 0.0;
+  double pv = 0.0;
+  int period = 0;
+  int period_len = PERIOD_START;
+
+  //inspiration from https://en.wikipedia.org/wiki/Plotting_algorithms_for_the_Mandelbrot_set#Optimized_escape_time_algorithms
+  for (it_count = 1; max_it_count > it_count && (u2 + v2 < bailout); it_count++) {
+    v = 2 * u * v + y;
+    u = u2 - v2 + x;
+    u2 = u * u;
+    v2 = v * v;
+
+    if (near_double(u, pu) && near_double(v, pv) && u2 + v2 < bailout) {
+      count_periodic(it_count, max_it_count);
+      return max_it_count;
+    }
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
+    }
   }
+
+  stats.iterations += it_count;
+  return it_count;
 }
 
-int main() {
-  print("[INFO] Config buffer address: ");
-  println_hex32((int) cfg_ptr);
+// returns escape iteration count of z_0 = x + iy for the julia set of c = cx + i*cy, escaping at |z|^2 >= bailout, using softfloat doubles
+int julia_it_double(double x, double y, double cx, double cy, int max_it_count, double bailout) {
+  double u = x;
+  double v = y;
+  double u2 = u*u;
+  double v2 = v*v;
+  int it_count;
 
-  println("[INFO] Loading config...");
+  double pu = u;
+  double pv = v;
+  int period = 0;
+  int period_len = PERIOD_START;
 
-  load_cfg(cfg_ptr);
+  for (it_count = 1; max_it_count > it_count && (u2 + v2 < bailout); it_count++) {
+    v = 2*u*v + cy;
+    u = u2 - v2 + cx;
+    v2 = v * v;
+    u2 = u * u;
 
-  println("[INFO] Config loaded!");
+    if (near_double(u, pu) && near_double(v, pv) && u2 + v2 < bailout) {
+      count_periodic(it_count, max_it_count);
+      return max_it_count;
+    }
+    if (++period == period_len) {
+      period = 0;
+      period_len <<= 1;
+      pu = u;
+      pv = v;
+    }
+  }
 
-  println("[INFO] Select a switch and press the BUTTON to generate an image!");
+  stats.iterations += it_count;
+  return it_count;
+}
 
-  while (1) {
-    if (get_btn()) {
-      int i = get_sw_i();
-      if (i < 0 || i > 9) { 
+/*
+  Interior culling.
+
+  Every point of the main cardioid and of the period-2 bulb (the disk of
+  radius 1/4 around -1) is in the mandelbrot set, so iterating them only
+  burns 'max_it_count' iterations to end up painted black. Both regions
+  have closed forms, see
+  https://en.wikipedia.org/wiki/Plotting_algorithms_for_the_Mandelbrot_set#Cardioid_/_bulb_checking
+*/
+
+// returns 1 if c = x + iy lies in the main cardioid or period-2 bulb, using Q4.28
+int in_main_bulbs_fixed(fixed x, fixed y) {
+  // both regions lie within -1.25 <= x <= 0.375 and |y| <= 0.65
+  if (x < -(FIX_ONE + FIX_ONE / 4) || x > FIX_ONE / 2 || y < -FIX_ONE || y > FIX_ONE) {
+    return 0;
+  }
+
+  long long y2 = (long long) y * y;
+
+  // cardioid: q(q + (x - 1/4)) <= y^2/4, where q = (x - 1/4)^2 + y^2
+  long long xq = x - FIX_ONE / 4;
+  long long q = (xq * xq + y2) >> FIX_FRAC_BITS;
+  if (q * (q + xq) <= y2 >> 2) {
+    return 1;
+  }
+
+  // period-2 bulb: (x + 1)^2 + y^2 <= 1/16
+  long long xb = x + FIX_ONE;
+  return xb * xb + y2 <= ((long long) FIX_ONE * FIX_ONE) / 16;
+}
+
+// returns 1 if c = x + iy lies in the main cardioid or period-2 bulb, using softfloat doubles
+int in_main_bulbs_double(double x, double y) {
+  if (x < -1.25 || x > 0.5 || y < -1.0 || y > 1.0) {
+    return 0;
+  }
+
+  double y2 = y * y;
+
+  double xq = x - 0.25;
+  double q = xq * xq + y2;
+  if (q * (q + xq) <= 0.25 * y2) {
+    return 1;
+  }
+
+  double xb = x + 1.0;
+  return xb * xb + y2 <= 0.0625;
+}
+
+/*
+  Perturbation.
+
+  Past a zoom of about 1e-13 neighbouring pixels no longer differ in a
+  double. Deep zooms instead iterate one reference orbit Z at the view
+  centre C in wide fixed point, and every pixel c = C + dc as the delta
+  dz = z - Z from it, which stays small enough for a double:
+
+    dz' = (2Z + dz)dz + dc
+
+  The deltas fail where the orbit passes close to 0 or the reference
+  escapes before the pixel does. Both are detected as |z| < |dz| (the
+  delta then carries the whole value) or running out of reference, and
+  fixed by rebasing: z itself becomes the delta from Z_0 = 0 and the
+  reference is followed from its start again, see
+  https://mathr.co.uk/blog/2021-05-14_deep_zoom_theory_and_practice.html
+*/
+
+// length of Z_0..Z_n in 'reference_orbit', up to where it escapes or n = max_it_count
+int reference_len = 0;
+
+// iterates the reference orbit of the deep zoom to 'reference_orbit'
+void compute_reference(struct deep* deep, int max_it_count) {
+  struct wide x, y, x2, y2, xy;
+  wide_from_double(&x, 0.0);
+  wide_from_double(&y, 0.0);
+
+  int n;
+  for (n = 0; ; n++) {
+    double u = wide_to_double(&x);
+    double v = wide_to_double(&y);
+    reference_orbit[n].real = u;
+    reference_orbit[n].imag = v;
+    // |Z| < 2 keeps the squares within Q4, IT_MAX fits the region but a longer orbit would not
+    if (n == max_it_count || n == REFERENCE_CAPACITY - 1 || u * u + v * v >= 4.0 || render_cancelled) {
+      break;
+    }
+
+    wide_mul(&x2, &x, &x);
+    wide_mul(&y2, &y, &y);
+    wide_mul(&xy, &x, &y);
+    wide_sub(&x, &x2, &y2);
+    wide_add(&x, &x, &deep->cx);
+    wide_add(&y, &xy, &xy);
+    wide_add(&y, &y, &deep->cy);
+  }
+  reference_len = n + 1;
+
+  print("[INFO] Reference orbit of '");
+  print_dec(n);
+  println("' iterations");
+}
+
+// returns escape iteration count of c = C + dx + i*dy for the mandelbrot set, C being the centre of the reference orbit
+int mandelbrot_it_perturbed(double dx, double dy, int max_it_count, double bailout) {
+  double du = 0.0;
+  double dv = 0.0;
+  double u = 0.0;
+  double v = 0.0;
+  int m = 0; // index into the reference orbit
+  int it_count;
+
+  for (it_count = 1; max_it_count > it_count && (u * u + v * v < bailout); it_count++) {
+    double tu = 2 * reference_orbit[m].real + du;
+    double tv = 2 * reference_orbit[m].imag + dv;
+    double nu = tu * du - tv * dv + dx;
+    dv = tu * dv + tv * du + dy;
+    du = nu;
+    m++;
+
+    u = reference_orbit[m].real + du;
+    v = reference_orbit[m].imag + dv;
+    if (u * u + v * v < du * du + dv * dv || m == reference_len - 1) {
+      du = u;
+      dv = v;
+      m = 0;
+      stats.rebased++;
+    }
+  }
+
+  stats.iterations += it_count;
+  return it_count;
+}
+
+/*
+  Views.
+
+  A view holds everything needed to iterate any single pixel of a
+  mandelbrot or julia render, so the renderers below can visit the
+  pixels in whatever order suits them. The coordinates of every column
+  and row are computed once per render in both number formats.
+
+  Only the band of rows [y0,y0+rows) is held in the iteration buffer at
+  a time, see the band scheduler below.
+*/
+#define MAX_DIM 4096
+
+struct view {
+  char type;
+  int width;
+  int height;
+  int max_it_count;
+  double bailout; // |z|^2 to escape at, the fixed kernels always use 4
+  int use_fixed;
+  struct deep* deep; // 0 unless a deep zoom, the coordinates are then deltas from its centre
+  double xmax;
+  double xmin;
+  double ymax;
+  double ymin;
+  double cx;
+  double cy;
+  fixed fcx;
+  fixed fcy;
+  int y0;
+  int rows;
+};
+
+double double_cols[MAX_DIM];
+double double_rows[MAX_DIM];
+fixed fixed_cols[MAX_DIM];
+fixed fixed_rows[MAX_DIM];
+
+/*
+  Symmetry.
+
+  Mandelbrot images are mirror-symmetric about the real axis, since the
+  orbit of conj(c) is the conjugate of the orbit of c. Julia images are
+  symmetric under 180 degree rotation about the origin, since z and -z
+  have the same square. Both hold bit for bit in either number format.
+
+  For every row (and for julia every column) we look for the one whose
+  coordinate is exactly the negation of its own, in the number format the
+  view iterates in. A pixel whose row and column both have a mirror is
+  stored to its mirror pixel as well when iterated. Off-centre views
+  simply end up without mirrors and are computed in full.
+*/
+
+// index of the row with the negated y-coord, or -1
+int mirror_rows[MAX_DIM];
+
+// index of the column with the negated x-coord (julia), the column itself (mandelbrot) or -1
+int mirror_cols[MAX_DIM];
+
+// returns the index k where coords[k] == x, or -1, coords must be strictly monotonic
+int find_fixed(fixed* coords, int res, fixed x) {
+  int descending = res > 1 && coords[0] > coords[1];
+  int lo = 0;
+  int hi = res - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (coords[mid] == x) {
+      return mid;
+    }
+    if ((coords[mid] < x) != descending) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return -1;
+}
+
+// returns the index k where coords[k] == x, or -1, coords must be strictly monotonic
+int find_double(double* coords, int res, double x) {
+  int descending = res > 1 && coords[0] > coords[1];
+  int lo = 0;
+  int hi = res - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (coords[mid] == x) {
+      return mid;
+    }
+    if ((coords[mid] < x) != descending) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return -1;
+}
+
+// fills 'mirror' with the index k where coords[k] == -coords[i], coords must be strictly monotonic
+void find_fixed_mirrors(fixed* coords, int* mirror, int res) {
+  for (int i = 0; i < res; i++) {
+    mirror[i] = find_fixed(coords, res, -coords[i]);
+  }
+}
+
+// fills 'mirror' with the index k where coords[k] == -coords[i], coords must be strictly monotonic
+void find_double_mirrors(double* coords, int* mirror, int res) {
+  for (int i = 0; i < res; i++) {
+    mirror[i] = find_double(coords, res, -coords[i]);
+  }
+}
+
+// fills 'mirror_rows' and 'mirror_cols' for the given view
+void fill_mirrors(struct view* v) {
+  // deltas are symmetric about the centre, not the axis
+  if (v->deep != 0) {
+    for (int j = 0; j < v->height; j++) {
+      mirror_rows[j] = -1;
+    }
+    for (int i = 0; i < v->width; i++) {
+      mirror_cols[i] = -1;
+    }
+    return;
+  }
+
+  if (v->use_fixed) {
+    find_fixed_mirrors(fixed_rows, mirror_rows, v->height);
+    find_fixed_mirrors(fixed_cols, mirror_cols, v->width);
+  } else {
+    find_double_mirrors(double_rows, mirror_rows, v->height);
+    find_double_mirrors(double_cols, mirror_cols, v->width);
+  }
+
+  // conjugation keeps x as is
+  if (v->type == 'M') {
+    for (int i = 0; i < v->width; i++) {
+      mirror_cols[i] = i;
+    }
+  }
+}
+
+/*
+  Fills coords[i] = base + i*span/res, rounded towards zero, for every i < res.
+
+  Steps by quotient and remainder instead of dividing i*span, since rv32
+  has no 64-bit division (softfloat.a does not provide __divdi3).
+*/
+void fill_fixed_coords(fixed* coords, fixed base, fixed span, int res) {
+  unsigned int abs_span = span < 0 ? -span : span;
+  unsigned int q_step = abs_span / res;
+  unsigned int r_step = abs_span % res;
+  unsigned int q = 0;
+  unsigned int r = 0;
+
+  for (int i = 0; i < res; i++) {
+    coords[i] = span < 0 ? base - (fixed) q : base + (fixed) q;
+    q += q_step;
+    r += r_step;
+    if (r >= (unsigned int) res) {
+      q++;
+      r -= res;
+    }
+  }
+}
+
+// sets up a view spanning [xmin,xmax) x (ymin,ymax] from the frame prepared when its entry was loaded, c is only used by julia views and deep only by mandelbrot views
+void setup_view(struct view* v, char type, double xmax, double xmin, double ymax, double ymin, double cx, double cy, int width, int height, struct frame* f, int max_it_count, double bail, struct deep* deep) {
+  v->type = type;
+  v->width = width;
+  v->height = height;
+  v->max_it_count = max_it_count;
+  v->bailout = bail * bail;
+  v->xmax = xmax;
+  v->xmin = xmin;
+  v->ymax = ymax;
+  v->ymin = ymin;
+  v->cx = cx;
+  v->cy = cy;
+  v->fcx = f->fcx;
+  v->fcy = f->fcy;
+  v->y0 = 0;
+  v->rows = height;
+  v->deep = deep;
+
+  if (deep != 0) {
+    for (int i = 0; i < width; i++) {
+      double_cols[i] = (i - width / 2) * f->step_x;
+    }
+    for (int j = 0; j < height; j++) {
+      double_rows[j] = (height / 2 - j) * f->step_y;
+    }
+  } else {
+    for (int i = 0; i < width; i++) {
+      double_cols[i] = xmin + i * f->step_x;
+    }
+    for (int j = 0; j < height; j++) {
+      double_rows[j] = ymax - (j * f->step_y);
+    }
+  }
+
+  v->use_fixed = f->use_fixed;
+  stats.pixels = width * height;
+  stats.kernel = deep != 0 ? 'P' : v->use_fixed ? 'Q' : 'D';
+  if (deep != 0) {
+    println("[INFO] Using perturbation kernel (deep zoom)");
+  } else if (v->use_fixed) {
+    println("[INFO] Using fixed-point (Q4.28) kernel");
+    fill_fixed_coords(fixed_cols, f->fxmin, f->fwidth, width);
+    fill_fixed_coords(fixed_rows, f->fymax, -f->fheight, height);
+  } else {
+    println("[INFO] Using double kernel");
+  }
+
+  fill_mirrors(v);
+}
+
+// places the columns and rows of a view 'step_x' and 'step_y' apart around (xc,yc), so views whose steps differ by powers of two share coordinates exactly
+void centre_view(struct view* v, double xc, double yc, double step_x, double step_y) {
+  for (int i = 0; i < v->width; i++) {
+    double_cols[i] = xc + (i - v->width / 2) * step_x;
+  }
+  for (int j = 0; j < v->height; j++) {
+    double_rows[j] = yc + (v->height / 2 - j) * step_y;
+  }
+  if (v->use_fixed) {
+    // offsets are converted whole, a rounded step would drift apart between views
+    fixed fxc = to_fixed(xc);
+    fixed fyc = to_fixed(yc);
+    for (int i = 0; i < v->width; i++) {
+      fixed_cols[i] = fxc + to_fixed((i - v->width / 2) * step_x);
+    }
+    for (int j = 0; j < v->height; j++) {
+      fixed_rows[j] = fyc + to_fixed((v->height / 2 - j) * step_y);
+    }
+  }
+  fill_mirrors(v);
+}
+
+// returns escape iteration count of pixel (i,j) of the given view
+int iterate_pixel(struct view* v, int i, int j) {
+  if (v->use_fixed) {
+    fixed x = fixed_cols[i];
+    fixed y = fixed_rows[j];
+    if (v->type == 'J') {
+      return julia_it_fixed(x, y, v->fcx, v->fcy, v->max_it_count);
+    }
+    if (in_main_bulbs_fixed(x, y)) {
+      stats.culled++;
+      return v->max_it_count;
+    }
+    return mandelbrot_it_fixed(x, y, v->max_it_count);
+  }
+
+  double x = double_cols[i];
+  double y = double_rows[j];
+  if (v->type == 'J') {
+    return julia_it_double(x, y, v->cx, v->cy, v->max_it_count, v->bailout);
+  }
+  if (v->deep != 0) {
+    return mandelbrot_it_perturbed(x, y, v->max_it_count, v->bailout);
+  }
+  if (in_main_bulbs_double(x, y)) {
+    stats.culled++;
+    return v->max_it_count;
+  }
+  return mandelbrot_it_double(x, y, v->max_it_count, v->bailout);
+}
+
+/*
+  Adaptive iteration budget.
+
+  With 'it=auto;' the budget is chosen per render. Deeper zooms need more
+  iterations before the boundary resolves, so the zoom depth, the binary
+  exponent of the pixel step, gives a cap. A coarse grid of the real view
+  is then iterated up to the cap, and the budget is twice the iteration
+  count that 99% of the escaping probes escaped within. Probes that never
+  escape are interior or need more than the cap, either way they say
+  nothing about where the escape counts end. Only if none escapes at
+  all is the cap itself used.
+*/
+
+#define PROBE_GRID 32
+#define PROBE_BUCKETS 64
+#define IT_AUTO_MIN 64
+#define IT_AUTO_PER_OCTAVE 64
+
+// returns the binary exponent of a positive double, read from the bit pattern so no softfloat is involved
+int exponent_of(double a) {
+  union { double d; long long bits; } pa;
+  pa.d = a;
+  return (int) ((pa.bits >> 52) & 0x7ff) - 1023;
+}
+
+// returns the iteration budget for a view set up with 'it=auto;', whose pixels are 'step' apart
+int choose_max_it(struct view* v, double step) {
+  int depth = -exponent_of(step);
+  int cap = IT_AUTO_PER_OCTAVE * depth;
+  if (cap < IT_DEFAULT) {
+    cap = IT_DEFAULT;
+  } else if (cap > IT_MAX) {
+    cap = IT_MAX;
+  }
+  // the render follows the same reference for any budget up to the cap
+  if (v->deep != 0) {
+    compute_reference(v->deep, cap);
+  }
+
+  // probing is not part of the render, keep it out of the stats
+  struct render_stats saved = stats;
+  int histogram[PROBE_BUCKETS] = {0};
+  int escaped = 0;
+  v->max_it_count = cap;
+  for (int pj = 0; pj < PROBE_GRID && !render_cancelled; pj++) {
+    int j = (2 * pj + 1) * v->height / (2 * PROBE_GRID);
+    for (int pi = 0; pi < PROBE_GRID; pi++) {
+      int i = (2 * pi + 1) * v->width / (2 * PROBE_GRID);
+      int it = iterate_pixel(v, i, j);
+      if (it < cap) {
+        histogram[it * PROBE_BUCKETS / (cap + 1)]++;
+        escaped++;
+      }
+    }
+  }
+  stats = saved;
+
+  // with no probe escaping the detail, if any, is beyond the cap
+  int budget = escaped > 0 ? IT_AUTO_MIN : cap;
+  int seen = 0;
+  for (int b = 0; b < PROBE_BUCKETS && escaped > 0; b++) {
+    seen += histogram[b];
+    if (100 * seen >= 99 * escaped) {
+      // the upper edge of the bucket
+      budget = 2 * ((b + 1) * (cap + 1) / PROBE_BUCKETS);
+      break;
+    }
+  }
+  if (budget < IT_AUTO_MIN) {
+    budget = IT_AUTO_MIN;
+  } else if (budget > cap) {
+    budget = cap;
+  }
+
+  print("[INFO] Chose '");
+  print_dec(budget);
+  println("' iterations (it=auto)");
+  return budget;
+}
+
+/*
+  Iteration buffer.
+
+  Renders first fill 'it_buffer' with the escape iteration count of every
+  pixel in the band of the view (row-major, 'width' per row, starting at
+  row 'y0') and only then paint it, so a renderer can skip pixels it
+  already knows. Unknown pixels hold
+  IT_UNKNOWN, which no kernel returns since counts start at 1.
+
+  'it_buffer' points into one of the render cache slots, see below.
+*/
+#define IT_UNKNOWN 0
+
+RENDER_LOCAL unsigned short* it_buffer;
+
+void clear_it_buffer(int pixels) {
+  for (int k = 0; k < pixels; k++) {
+    it_buffer[k] = IT_UNKNOWN;
+  }
+}
+
+// stores the escape iteration count of pixel (i,j) and of its mirror pixel
+void store_pixel(struct view* v, int i, int j, int it_count) {
+  it_buffer[(j - v->y0) * v->width + i] = it_count;
+
+  // the mirror pixel may lie outside the band
+  int mi = mirror_cols[i];
+  int mj = mirror_rows[j];
+  if (mi >= 0 && mj >= v->y0 && mj < v->y0 + v->rows && (mi != i || mj != j)) {
+    it_buffer[(mj - v->y0) * v->width + mi] = it_count;
+    stats.mirrored++;
+  }
+}
+
+// returns escape iteration count of pixel (i,j), only iterating it if not yet known
+int resolve_pixel(struct view* v, int i, int j) {
+  unsigned short* it = &it_buffer[(j - v->y0) * v->width + i];
+  if (*it == IT_UNKNOWN) {
+    store_pixel(v, i, j, iterate_pixel(v, i, j));
+  }
+  return *it;
+}
+
+/*
+  Interleaved fixed-point kernel.
+
+  Every iteration of one orbit waits on the multiplies of the one before,
+  so a single orbit leaves the multiplier idle most of the time. Brute
+  force renders of Q4.28 views instead advance three orbits of a row in
+  lockstep, whose multiplies are independent and overlap. A lane whose
+  orbit is done stores it and takes the next unknown pixel of the row.
+  The lanes are unrolled by hand into locals, the row and the rounding
+  are the same for all of them, so only their orbits and columns differ.
+
+  Each lane runs exactly the iteration of 'mandelbrot_it_fixed' and
+  'julia_it_fixed', periodicity checking and culling included, so the
+  image and the statistics are the same as one pixel at a time.
+*/
+
+// returns the first unknown pixel of row j at or after column i, culling those in the main bulbs, or the width once there is none
+int next_lane_pixel(struct view* v, int j, int i) {
+  unsigned short* row = &it_buffer[(j - v->y0) * v->width];
+  for (; i < v->width; i++) {
+    if (row[i] != IT_UNKNOWN) {
+      continue;
+    }
+    if (v->type == 'M' && in_main_bulbs_fixed(fixed_cols[i], fixed_rows[j])) {
+      stats.culled++;
+      store_pixel(v, i, j, v->max_it_count);
+      continue;
+    }
+    return i;
+  }
+  return v->width;
+}
+
+// starts lane n on the next pixel of the row, or leaves it idle with i<n> at the width
+#define LANE_FILL(n) \
+  i##n = next_lane_pixel(v, j, next); \
+  next = i##n + 1; \
+  if (i##n < v->width) { \
+    fixed x = fixed_cols[i##n]; \
+    cx##n = julia ? v->fcx : x; \
+    u##n = julia ? x : 0; \
+    v##n = julia ? y : 0; \
+    uu##n = (long long) u##n * u##n; \
+    vv##n = (long long) v##n * v##n; \
+    pu##n = u##n; \
+    pv##n = v##n; \
+    period##n = 0; \
+    len##n = PERIOD_START; \
+    it##n = 1; \
+  } else { \
+    busy--; \
+  }
+
+// advances the orbit of lane n one iteration, and once it is done stores it and starts the lane on the next pixel
+#define LANE_STEP(n) \
+  if (i##n < v->width) { \
+    int done = 0; \
+    if (max_it_count <= it##n || uu##n + vv##n >= FIX_BAILOUT) { \
+      stats.iterations += it##n; \
+      done = it##n; \
+    } else { \
+      long long uv = (long long) u##n * v##n; \
+      uv += (uv >> 63) & round; \
+      v##n = (fixed) (uv >> (FIX_FRAC_BITS - 1)) + cy; \
+      u##n = (fixed) ((uu##n - vv##n) >> FIX_FRAC_BITS) + cx##n; \
+      uu##n = (long long) u##n * u##n; \
+      vv##n = (long long) v##n * v##n; \
+      if (near_fixed(u##n, pu##n) && near_fixed(v##n, pv##n) && uu##n + vv##n < FIX_BAILOUT) { \
+        count_periodic(it##n, max_it_count); \
+        done = max_it_count; \
+      } else { \
+        if (++period##n == len##n) { \
+          period##n = 0; \
+          len##n <<= 1; \
+          pu##n = u##n; \
+          pv##n = v##n; \
+        } \
+        it##n++; \
+      } \
+    } \
+    if (done != 0) { \
+      store_pixel(v, i##n, j, done); \
+      LANE_FILL(n) \
+    } \
+  }
+
+// iterates every unknown pixel of row j of a Q4.28 view, three at a time
+void render_row_lanes(struct view* v, int j) {
+  int julia = v->type == 'J';
+  int max_it_count = v->max_it_count;
+  fixed y = fixed_rows[j];
+  fixed cy = julia ? v->fcy : y;
+  // added to negative 2uv, see 'mandelbrot_it_fixed'
+  long long round = julia ? 0 : (1LL << (FIX_FRAC_BITS - 1)) - 1;
+
+  int i0 = 0, it0 = 0, period0 = 0, len0 = 0;
+  int i1 = 0, it1 = 0, period1 = 0, len1 = 0;
+  int i2 = 0, it2 = 0, period2 = 0, len2 = 0;
+  fixed cx0 = 0, u0 = 0, v0 = 0, pu0 = 0, pv0 = 0;
+  fixed cx1 = 0, u1 = 0, v1 = 0, pu1 = 0, pv1 = 0;
+  fixed cx2 = 0, u2 = 0, v2 = 0, pu2 = 0, pv2 = 0;
+  long long uu0 = 0, vv0 = 0, uu1 = 0, vv1 = 0, uu2 = 0, vv2 = 0;
+
+  int next = 0;
+  int busy = 3;
+  LANE_FILL(0)
+  LANE_FILL(1)
+  LANE_FILL(2)
+  while (busy > 0) {
+    LANE_STEP(0)
+    LANE_STEP(1)
+    LANE_STEP(2)
+  }
+}
+
+// iterates every unknown pixel of rows y to y + rows - 1 of the band, several at a time where the kernel allows
+void render_rows(struct view* v, int y, int rows) {
+  for (int j = y; j < y + rows && !render_cancelled; j++) {
+    //print new progress
+    print_progress(j, v->height);
+    unsigned long long before = stats.iterations;
+
+    // a row that is its own mirror holds pixel pairs, which must be iterated in order
+    if (mirror_rows[j] != j && RENDER_ROW(v, j)) {
+      // iterated by a vector kernel
+    } else if (v->use_fixed && mirror_rows[j] != j) {
+      render_row_lanes(v, j);
+    } else {
+      for (int i = 0; i < v->width; i++) {
+        resolve_pixel(v, i, j);
+      }
+    }
+    note_rows(j, 1, stats.iterations - before);
+  }
+}
+
+// iterates every pixel of the band
+void render_brute(struct view* v) {
+  render_rows(v, v->y0, v->rows);
+}
+
+/*
+  Mariani-Silver subdivision.
+
+  Mandelbrot and julia sets are connected, so if every pixel on the
+  border of a rectangle escapes after the same number of iterations, so
+  does every pixel inside it. We iterate the border of a rectangle and
+  either fill its inside or split it in two along the longer side and
+  recurse. Neighbouring rectangles share their border pixels, which the
+  iteration buffer makes sure we only iterate once.
+
+  See https://en.wikibooks.org/wiki/Fractals/Iterations_in_the_complex_plane/Mariani-Silver_algorithm
+*/
+
+// side of the tiles the frame is first cut into
+#define MS_TILE 32
+
+// rectangles with both sides this short or shorter are iterated pixel by pixel
+#define MS_MIN 4
+
+// renders the rectangle with corners (x0,y0) and (x1,y1), inclusive
+void render_ms_rect(struct view* v, int x0, int y0, int x1, int y1) {
+  int it = resolve_pixel(v, x0, y0);
+  int uniform = 1;
+  int i, j;
+
+  for (i = x0; i <= x1; i++) {
+    uniform &= resolve_pixel(v, i, y0) == it;
+    uniform &= resolve_pixel(v, i, y1) == it;
+  }
+  for (j = y0 + 1; j < y1; j++) {
+    uniform &= resolve_pixel(v, x0, j) == it;
+    uniform &= resolve_pixel(v, x1, j) == it;
+  }
+
+  // nothing inside the border
+  if (x1 - x0 < 2 || y1 - y0 < 2) {
+    return;
+  }
+
+  if (uniform) {
+    for (j = y0 + 1; j < y1; j++) {
+      unsigned short* row = &it_buffer[(j - v->y0) * v->width];
+      for (i = x0 + 1; i < x1; i++) {
+        if (row[i] == IT_UNKNOWN) {
+          row[i] = it;
+          stats.filled++;
+        }
+      }
+    }
+  } else if (x1 - x0 <= MS_MIN && y1 - y0 <= MS_MIN) {
+    for (j = y0 + 1; j < y1; j++) {
+      for (i = x0 + 1; i < x1; i++) {
+        resolve_pixel(v, i, j);
+      }
+    }
+  } else if (x1 - x0 >= y1 - y0) {
+    int xm = (x0 + x1) / 2;
+    render_ms_rect(v, x0, y0, xm, y1);
+    render_ms_rect(v, xm, y0, x1, y1);
+  } else {
+    int ym = (y0 + y1) / 2;
+    render_ms_rect(v, x0, y0, x1, ym);
+    render_ms_rect(v, x0, ym, x1, y1);
+  }
+}
+
+// renders the band tile by tile using Mariani-Silver subdivision
+void render_ms(struct view* v) {
+  // a rectangle needs two rows and columns
+  if (v->rows < 2 || v->width < 2) {
+    render_brute(v);
+    return;
+  }
+
+  int last_row = v->y0 + v->rows - 1;
+  int last_col = v->width - 1;
+  for (int ty = v->y0; ty < last_row; ty += MS_TILE) {
+    //print new progress
+    print_progress(ty, v->height);
+
+    int y1 = ty + MS_TILE < last_row ? ty + MS_TILE : last_row;
+    unsigned long long before = stats.iterations;
+    for (int tx = 0; tx < last_col && !render_cancelled; tx += MS_TILE) {
+      int x1 = tx + MS_TILE < last_col ? tx + MS_TILE : last_col;
+      render_ms_rect(v, tx, ty, x1, y1);
+      console_poll();
+    }
+    note_rows(ty, y1 - ty + 1, stats.iterations - before);
+  }
+}
+
+/*
+  Render cache.
+
+  With x = xmin + i*step_x, pixel (2i,2j) of a render at 2W x 2H lands
+  exactly on pixel (i,j) of the same view at W x H, in both number
+  formats. So we keep the iteration buffers of recent renders in
+  'it_cache_data' and reuse them. A view we already have at a higher
+  resolution is a plain decimation, and a view we have at a lower
+  resolution starts with those samples known and only iterates the rest.
+  Mariani-Silver fills rectangles it does not iterate, so its counts are
+  not those of brute force and depend on the resolution. A cached view
+  is only reused by a render in the same mode, and in Mariani-Silver
+  only at the same resolution.
+
+  Only frames of up to IT_CACHE_SLOT_SIZE pixels are cached, larger ones
+  are rendered in bands (see below).
+
+  The directory is static, so it is forgotten whenever dtekv-run restarts
+  the program, which keeps stale slots from ever being trusted.
+*/
+#define IT_CACHE_SLOTS 8
+#define IT_CACHE_SLOT_SIZE (256 * 256)
+
+struct it_cache_entry {
+  int used; // value of 'it_cache_clock' when last used, 0 if empty
+  char type;
+  int mode;
+  int use_fixed;
+  int max_it_count;
+  double bailout;
+  int width;
+  int height;
+  double xmax;
+  double xmin;
+  double ymax;
+  double ymin;
+  double cx;
+  double cy;
+};
+
+struct it_cache_entry it_cache[IT_CACHE_SLOTS];
+int it_cache_clock = 0;
+
+// forgets every cached render
+void clear_it_cache() {
+  for (int s = 0; s < IT_CACHE_SLOTS; s++) {
+    it_cache[s].used = 0;
+  }
+}
+
+// returns 1 if the cache entry holds the same view as v rendered in the given mode, at any resolution
+int same_cached_view(struct it_cache_entry* e, struct view* v, int mode) {
+  return e->used && e->type == v->type && e->mode == mode && e->use_fixed == v->use_fixed && e->max_it_count == v->max_it_count && e->bailout == v->bailout
+    && e->xmax == v->xmax && e->xmin == v->xmin && e->ymax == v->ymax && e->ymin == v->ymin
+    && e->cx == v->cx && e->cy == v->cy;
+}
+
+// returns 1 if b is a power of two multiple of a
+int is_pow2_multiple(int a, int b) {
+  if (b < a || b % a != 0) {
+    return 0;
+  }
+  int k = b / a;
+  return (k & (k - 1)) == 0;
+}
+
+// returns 1 if w2 x h2 is w1 x h1 scaled by a power of two
+int is_pow2_scale(int w1, int h1, int w2, int h2) {
+  return is_pow2_multiple(w1, w2) && h2 == h1 * (w2 / w1);
+}
+
+// returns the slot holding the view at the lowest resolution >= its own, or -1
+int find_finer_view(struct view* v, int mode) {
+  int best = -1;
+  for (int s = 0; s < IT_CACHE_SLOTS; s++) {
+    if (same_cached_view(&it_cache[s], v, mode) && is_pow2_scale(v->width, v->height, it_cache[s].width, it_cache[s].height)
+        && (best < 0 || it_cache[s].width < it_cache[best].width)) {
+      best = s;
+    }
+  }
+  return best;
+}
+
+// returns the slot holding the view at the highest resolution < its own, or -1
+int find_coarser_view(struct view* v, int mode) {
+  int best = -1;
+  for (int s = 0; s < IT_CACHE_SLOTS; s++) {
+    if (same_cached_view(&it_cache[s], v, mode) && it_cache[s].width < v->width
+        && is_pow2_scale(it_cache[s].width, it_cache[s].height, v->width, v->height)
+        && (best < 0 || it_cache[s].width > it_cache[best].width)) {
+      best = s;
+    }
+  }
+  return best;
+}
+
+// returns the least recently used slot other than 'keep', emptied
+int claim_cache_slot(int keep) {
+  int slot = -1;
+  for (int s = 0; s < IT_CACHE_SLOTS; s++) {
+    if (s != keep && (slot < 0 || it_cache[s].used < it_cache[slot].used)) {
+      slot = s;
+    }
+  }
+  it_cache[slot].used = 0;
+  return slot;
+}
+
+unsigned short* cache_slot_data(int slot) {
+  return &it_cache_data[slot * IT_CACHE_SLOT_SIZE];
+}
+
+// records the view now held by the slot, rendered in the given mode
+void store_cached_view(int slot, struct view* v, int mode) {
+  struct it_cache_entry* e = &it_cache[slot];
+  e->type = v->type;
+  e->mode = mode;
+  e->use_fixed = v->use_fixed;
+  e->max_it_count = v->max_it_count;
+  e->bailout = v->bailout;
+  e->width = v->width;
+  e->height = v->height;
+  e->xmax = v->xmax;
+  e->xmin = v->xmin;
+  e->ymax = v->ymax;
+  e->ymin = v->ymin;
+  e->cx = v->cx;
+  e->cy = v->cy;
+  e->used = ++it_cache_clock;
+}
+
+// copies every k:th sample of the finer render in 'src' to 'it_buffer'
+void decimate_view(struct view* v, unsigned short* src, int src_width) {
+  int k = src_width / v->width;
+  for (int j = 0; j < v->height; j++) {
+    for (int i = 0; i < v->width; i++) {
+      it_buffer[j * v->width + i] = src[(j * k) * src_width + i * k];
+    }
+  }
+  stats.reused += v->width * v->height;
+}
+
+// copies the coarser render in 'src' to every k:th sample of 'it_buffer'
+void upsample_view(struct view* v, unsigned short* src, int src_width, int src_height) {
+  int k = v->width / src_width;
+  for (int j = 0; j < src_height; j++) {
+    for (int i = 0; i < src_width; i++) {
+      it_buffer[(j * k) * v->width + i * k] = src[j * src_width + i];
+    }
+  }
+  stats.reused += src_width * src_height;
+}
+
+// fills the unknown pixels of the band in 'it_buffer' using the given render mode
+void render_band(struct view* v, int mode) {
+  if (mode == MODE_MARIANI_SILVER) {
+    render_ms(v);
+  } else {
+    render_brute(v);
+  }
+}
+
+// fills 'it_buffer' with the whole view using the render cache, the view must fit IT_CACHE_SLOT_SIZE
+void render_view(struct view* v, int mode) {
+  int src = find_finer_view(v, mode);
+  if (src >= 0 && it_cache[src].width == v->width) {
+    println("[INFO] Reusing cached render of the same view");
+    it_buffer = cache_slot_data(src);
+    it_cache[src].used = ++it_cache_clock;
+    stats.reused += v->width * v->height;
+    return;
+  }
+
+  if (mode == MODE_MARIANI_SILVER) {
+    src = -1;
+  } else if (src < 0) {
+    src = find_coarser_view(v, mode);
+  }
+  int slot = claim_cache_slot(src);
+  it_buffer = cache_slot_data(slot);
+  clear_it_buffer(v->width * v->height);
+
+  if (src >= 0) {
+    print("[INFO] Reusing cached render at resolution '");
+    print_dims(it_cache[src].width, it_cache[src].height);
+    printlnc('\'');
+    if (it_cache[src].width > v->width) {
+      decimate_view(v, cache_slot_data(src), it_cache[src].width);
+      store_cached_view(slot, v, mode);
+      return;
+    }
+    upsample_view(v, cache_slot_data(src), it_cache[src].width, it_cache[src].height);
+  }
+
+  begin_progress();
+  if (mode == MODE_MARIANI_SILVER) {
+    println("[INFO] Using Mariani-Silver subdivision");
+  }
+  render_band(v, mode);
+  // a cancelled render leaves the slot empty
+  if (!render_cancelled) {
+    store_cached_view(slot, v, mode);
+  }
+}
+
+/*
+  Image writer.
+
+  Bands are painted through an image writer, which knows the format of
+  the image. A PPM image holds the palette colour of every pixel in 3
+  bytes. A PGM image holds its escape iteration count minus one instead,
+  in 1 byte while 'max_it_count' <= 256 and else in 2 (big endian), so
+  painting and downloading it moves a third of the bytes. The fractal
+  type and 'max_it_count' go in a header comment, from which
+  host/expand.c paints the very PPM image we would have written.
+
+  A QOI image is compressed as the bands are painted, so the raw pixels
+  are never stored. Fractals have long runs of one colour, which QOI
+  stores in a byte per up to 62 pixels, and bands of slowly changing
+  colour, which mostly fit its 1 and 2 byte differences. Mirrored bands
+  cannot be copied from a compressed image, so they are rendered.
+
+  See https://qoiformat.org/qoi-specification.pdf
+*/
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+
+struct image_writer {
+  int fmt;
+  int bpp; // bytes per pixel, at most for QOI
+  char* pixels; // first pixel, past the header
+
+  // QOI encoder state, pixels are packed as 0xAARRGGBB
+  char* cursor;
+  unsigned int prev;
+  int run;
+  unsigned int index[64];
+};
+
+// returns how many bytes a pixel takes in the given format, at most for QOI
+int format_bpp(int fmt, int max_it_count) {
+  if (fmt == FMT_PGM) {
+    return max_it_count <= 256 ? 1 : 2;
+  } else if (fmt == FMT_QOI) {
+    return 4;
+  }
+  return 3;
+}
+
+void qoi_flush_run(struct image_writer* img) {
+  if (img->run > 0) {
+    *img->cursor = QOI_OP_RUN | (img->run - 1); img->cursor++;
+    img->run = 0;
+  }
+}
+
+// encodes the next pixel of the QOI image
+void qoi_push(struct image_writer* img, char* rgb) {
+  unsigned int r = (unsigned char) rgb[0];
+  unsigned int g = (unsigned char) rgb[1];
+  unsigned int b = (unsigned char) rgb[2];
+  unsigned int px = 0xff000000 | (r << 16) | (g << 8) | b;
+
+  if (px == img->prev) {
+    img->run++;
+    if (img->run == 62) {
+      qoi_flush_run(img);
+    }
+    return;
+  }
+  qoi_flush_run(img);
+
+  char* ptr = img->cursor;
+  int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) & 63;
+  if (img->index[hash] == px) {
+    *ptr = QOI_OP_INDEX | hash; ptr++;
+  } else {
+    img->index[hash] = px;
+
+    // differences wrap around
+    int dr = (signed char) (r - ((img->prev >> 16) & 0xff));
+    int dg = (signed char) (g - ((img->prev >> 8) & 0xff));
+    int db = (signed char) (b - (img->prev & 0xff));
+    int dr_dg = dr - dg;
+    int db_dg = db - dg;
+    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+      *ptr = QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2); ptr++;
+    } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+      *ptr = QOI_OP_LUMA | (dg + 32); ptr++;
+      *ptr = ((dr_dg + 8) << 4) | (db_dg + 8); ptr++;
+    } else {
+      *ptr = QOI_OP_RGB; ptr++;
+      *ptr = r; ptr++; *ptr = g; ptr++; *ptr = b; ptr++;
+    }
+  }
+  img->cursor = ptr;
+  img->prev = px;
+}
+
+// returns the most bytes a pixel may take with the given options, whatever 'it=auto' chooses
+int bpp_bound(struct options* opts) {
+  return format_bpp(opts->fmt, opts->max_it == IT_AUTO ? IT_MAX : opts->max_it);
+}
+
+// writes the header of the image of the view to dst and prepares to paint its pixels
+void begin_image(struct image_writer* img, struct view* v, int fmt, char* dst) {
+  render_report->type = v->type;
+  render_report->width = v->width;
+  render_report->height = v->height;
+  render_report->max_it = v->max_it_count;
+  render_report->frames++;
+
+  img->fmt = fmt;
+  img->bpp = format_bpp(fmt, v->max_it_count);
+  if (fmt == FMT_PGM) {
+    println("[INFO] Writing indexed PGM, expand it to PPM with expand.host");
+    write_pgm_header(&dst, v->width, v->height, v->max_it_count - 1, v->type, v->max_it_count);
+  } else if (fmt == FMT_QOI) {
+    println("[INFO] Writing QOI, decode it to PPM with expand.host");
+    write_qoi_header(&dst, v->width, v->height);
+    img->cursor = dst;
+    img->prev = 0xff000000;
+    img->run = 0;
+    for (int k = 0; k < 64; k++) {
+      img->index[k] = 0;
+    }
+  } else {
+    write_ppm_header(&dst, v->width, v->height);
+  }
+  img->pixels = dst;
+}
+
+// finishes the image and returns its end
+char* end_image(struct image_writer* img, struct view* v) {
+  if (img->fmt != FMT_QOI) {
+    return img->pixels + v->width * v->height * img->bpp;
+  }
+
+  qoi_flush_run(img);
+  for (int k = 0; k < 7; k++) {
+    *img->cursor = 0; img->cursor++;
+  }
+  *img->cursor = 1; img->cursor++;
+
+  print("[INFO] Compressed '");
+  print_dec(v->width * v->height * 3);
+  print("' bytes of pixels to '");
+  print_dec(img->cursor - img->pixels);
+  println("' bytes");
+  return img->cursor;
+}
+
+/*
+  Band scheduler.
+
+  Frames that fit a render cache slot are rendered whole through the
+  cache. Larger ones are cut into bands of as many full rows as fit a
+  slot, which is claimed as scratch. Every band is rendered and painted
+  to the image before the next one starts, so the working memory stays
+  one slot whatever the resolution and only the image itself grows.
+
+  A band whose every pixel mirrors a pixel of an earlier band is not
+  rendered at all. The earlier bands paint those rows along with their
+  own while their escape counts are at hand, which halves the work of a
+  symmetric view. Every row of the image is painted and tallied once.
+*/
+
+// adds the escape counts of rows y to y + rows - 1, held by 'it_buffer', to the report
+void tally_rows(struct view* v, int y, int rows) {
+  struct render_report* r = render_report;
+  if (r->bucket_width == 0) {
+    r->bucket_width = (v->max_it_count + REPORT_BUCKETS - 1) / REPORT_BUCKETS;
+  }
+  unsigned short* it = &it_buffer[(y - v->y0) * v->width];
+  int count = rows * v->width;
+  for (int k = 0; k < count; k++) {
+    if (it[k] >= v->max_it_count) {
+      r->interior++;
+      continue;
+    }
+    int b = (it[k] - 1) / r->bucket_width;
+    r->histogram[b < REPORT_BUCKETS ? b : REPORT_BUCKETS - 1]++;
+    r->escaped++;
+  }
+}
+
+// paints the band held by 'it_buffer' to its rows of the image
+void paint_band(struct view* v, struct image_writer* img) {
+  tally_rows(v, v->y0, v->rows);
+  char* dst = img->pixels + v->y0 * v->width * img->bpp;
+  int count = v->rows * v->width;
+  if (img->fmt == FMT_QOI) {
+    char rgb[3];
+    for (int k = 0; k < count; k++) {
+      if (v->type == 'J') {
+        write_julia_pixel(rgb, it_buffer[k]);
+      } else {
+        write_mandelbrot_pixel(rgb, it_buffer[k], v->max_it_count);
+      }
+      qoi_push(img, rgb);
+    }
+  } else if (img->fmt == FMT_PGM && img->bpp == 1) {
+    for (int k = 0; k < count; k++) {
+      *dst = it_buffer[k] - 1; dst++;
+    }
+  } else if (img->fmt == FMT_PGM) {
+    for (int k = 0; k < count; k++) {
+      *dst = (it_buffer[k] - 1) >> 8; dst++;
+      *dst = (it_buffer[k] - 1) & 0xff; dst++;
+    }
+  } else if (v->type == 'J') {
+    for (int k = 0; k < count; k++) {
+      dst = write_julia_pixel(dst, it_buffer[k]);
+    }
+  } else {
+    for (int k = 0; k < count; k++) {
+      dst = write_mandelbrot_pixel(dst, it_buffer[k], v->max_it_count);
+    }
+  }
+}
+
+// returns 1 if every pixel of the band has a mirror in the rows before it, which an image of the given format can be copied from
+int band_is_mirrored(struct view* v, int fmt) {
+  if (fmt == FMT_QOI) {
+    return 0;
+  }
+  for (int j = v->y0; j < v->y0 + v->rows; j++) {
+    if (mirror_rows[j] < 0 || mirror_rows[j] >= v->y0) {
+      return 0;
+    }
+  }
+  for (int i = 0; i < v->width; i++) {
+    if (mirror_cols[i] < 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// rows whose mirror row lies in a band that is not rendered, see 'render_image'
+char copied_rows[MAX_DIM];
+
+// writes the pixel with the given escape count in the format of the image, which is not QOI, and returns the byte after it
+char* paint_pixel(struct view* v, struct image_writer* img, char* dst, int it_count) {
+  if (img->fmt == FMT_PGM && img->bpp == 1) {
+    *dst = it_count - 1; dst++;
+  } else if (img->fmt == FMT_PGM) {
+    *dst = (it_count - 1) >> 8; dst++;
+    *dst = (it_count - 1) & 0xff; dst++;
+  } else if (v->type == 'J') {
+    dst = write_julia_pixel(dst, it_count);
+  } else {
+    dst = write_mandelbrot_pixel(dst, it_count, v->max_it_count);
+  }
+  return dst;
+}
+
+// paints the rows of the band held by 'it_buffer' that a mirrored band holds as well to their mirror rows
+void paint_mirrored_rows(struct view* v, struct image_writer* img) {
+  for (int j = v->y0; j < v->y0 + v->rows; j++) {
+    if (!copied_rows[j]) {
+      continue;
+    }
+    unsigned short* it = &it_buffer[(j - v->y0) * v->width];
+    char* dst = img->pixels + mirror_rows[j] * v->width * img->bpp;
+    for (int i = 0; i < v->width; i++) {
+      dst = paint_pixel(v, img, dst, it[mirror_cols[i]]);
+    }
+    // the mirror row holds the same escape counts, only its columns are in another order
+    tally_rows(v, j, 1);
+  }
+}
+
+// returns 1 if every pixel of the band was painted with its mirror already, else 0
+int skip_mirrored_band(struct view* v, struct image_writer* img) {
+  if (!band_is_mirrored(v, img->fmt)) {
+    return 0;
+  }
+  stats.mirrored += v->rows * v->width;
+  return 1;
+}
+
+// renders the view and paints it to the image
+void render_image(struct view* v, int mode, struct image_writer* img) {
+  render_report->mode = mode;
+  // the bounds of a deep zoom are too coarse to tell cached views apart
+  if (v->width * v->height <= IT_CACHE_SLOT_SIZE && v->deep == 0) {
+    render_view(v, mode);
+    paint_band(v, img);
+    return;
+  }
+
+  int band = IT_CACHE_SLOT_SIZE / v->width;
+  print("[INFO] Rendering in bands of '");
+  print_dec(band);
+  println("' rows");
+  if (mode == MODE_MARIANI_SILVER) {
+    println("[INFO] Using Mariani-Silver subdivision");
+  }
+
+  // mirrored bands are never rendered, the rows they mirror paint them
+  for (int y0 = 0; y0 < v->height; y0 += band) {
+    v->y0 = y0;
+    v->rows = y0 + band < v->height ? band : v->height - y0;
+    for (int j = y0; j < y0 + v->rows; j++) {
+      copied_rows[j] = 0;
+    }
+    if (band_is_mirrored(v, img->fmt)) {
+      for (int j = y0; j < y0 + v->rows; j++) {
+        copied_rows[mirror_rows[j]] = 1;
+      }
+    }
+  }
+
+  it_buffer = cache_slot_data(claim_cache_slot(-1));
+  begin_progress();
+  for (int y0 = 0; y0 < v->height && !render_cancelled; y0 += band) {
+    v->y0 = y0;
+    v->rows = y0 + band < v->height ? band : v->height - y0;
+    if (skip_mirrored_band(v, img)) {
+      print_progress(y0, v->height);
+      continue;
+    }
+    clear_it_buffer(v->rows * v->width);
+    render_band(v, mode);
+    paint_band(v, img);
+    paint_mirrored_rows(v, img);
+  }
+}
+
+// returns 1 if an image of the given size is supported and fits the image buffer, else prints why not
+int check_dims(int width, int height, int bpp) {
+  if (width < 1 || height < 1 || width > MAX_DIM || height > MAX_DIM) {
+    print("[SEVERE] Bad resolution '");
+    print_dims(width, height);
+    print("', width and height must be within 1 and ");
+    print_dec(MAX_DIM);
+    printlnc('!');
+    return 0;
+  }
+  // the header takes at most 64 bytes
+  if (width * height * bpp + 64 > IMAGE_BUFFER_SIZE) {
+    print("[SEVERE] Resolution '");
+    print_dims(width, height);
+    println("' does not fit the image buffer!");
+    return 0;
+  }
+  return 1;
+}
+
+/*
+  Zoom sequences.
+
+  With 'frames=<n>;' an entry renders n frames zooming from its bounds
+  into their centre, the span shrinking by the same factor every frame.
+  The frames are written one after another behind a batch directory
+  (see batch.h), so the sequence is downloaded in one go and split into
+  frames by split.host.
+
+  The first frame is set up like a single image of the entry, so it is
+  that very image. Every later frame is placed around the centre by
+  'centre_view', so when the factor is a power of two, e.g. the default
+  of 1/2, the even columns and rows of a frame lie exactly on columns
+  and rows of the previous frame, in either number format. Their escape
+  counts are copied from the previous frame, which stays in a render
+  cache slot, and only the rest is iterated. With a factor of 1/2 that
+  is a quarter of the pixels. The second frame only reuses the columns
+  and rows of the first that happen to round to the same coordinates,
+  e.g. all of them for 'M;-0.5;-2.5;1.0;-1.0;256;' but about 60% for
+  'M;0.31;-1.73;1.13;-0.91;256;'. Frames larger than a slot are
+  rendered in bands from scratch.
+*/
+
+// the coordinates of the previous frame
+double prev_double_cols[MAX_DIM];
+double prev_double_rows[MAX_DIM];
+fixed prev_fixed_cols[MAX_DIM];
+fixed prev_fixed_rows[MAX_DIM];
+
+// the columns of the frame that lie on a column of the previous frame, and that column
+int reused_cols[MAX_DIM];
+int reused_prev_cols[MAX_DIM];
+
+// returns p rounded up to BATCH_ALIGN, where images and frames start
+char* align_image(char* p) {
+  return (char*) (((int) p + BATCH_ALIGN - 1) & -BATCH_ALIGN);
+}
+
+// returns the factor r with r^steps = ratio, exactly a power of two if it is one to within rounding
+double zoom_factor(double ratio, int steps) {
+  // bisection, there is no libm on the board
+  double lo = ratio < 1.0 ? ratio : 1.0;
+  double hi = ratio < 1.0 ? 1.0 : ratio;
+  for (int k = 0; k < 64; k++) {
+    double r = (lo + hi) / 2;
+    double p = 1.0;
+    for (int n = 0; n < steps; n++) {
+      p *= r;
+    }
+    if (p < ratio) {
+      lo = r;
+    } else {
+      hi = r;
+    }
+  }
+  double r = (lo + hi) / 2;
+
+  // only an exact power of two lines frames up for reuse
+  double pow2 = 1.0;
+  while (pow2 > r * 1.5) {
+    pow2 /= 2;
+  }
+  while (pow2 < r / 1.5) {
+    pow2 *= 2;
+  }
+  double error = r - pow2;
+  if (error < 0) {
+    error = -error;
+  }
+  return error < pow2 * 1e-12 ? pow2 : r;
+}
+
+// returns the most bytes the image or zoom sequence of an entry may take
+int entry_bound(int width, int height, struct options* opts, int bpp) {
+  int image = width * height * bpp + 64;
+  if (opts->frames <= 1) {
+    return image;
+  }
+  return sizeof(struct batch_directory) + opts->frames * (sizeof(struct batch_slot) + image + BATCH_ALIGN) + BATCH_ALIGN;
+}
+
+// copies the escape counts of pixels that lie exactly on pixels of the previous frame
+void reuse_previous_frame(struct view* v, unsigned short* prev) {
+  // the columns are matched once per frame, the rows once per row
+  int cols = 0;
+  for (int i = 0; i < v->width; i++) {
+    int pi = v->use_fixed ? find_fixed(prev_fixed_cols, v->width, fixed_cols[i])
+                          : find_double(prev_double_cols, v->width, double_cols[i]);
+    if (pi >= 0) {
+      reused_cols[cols] = i;
+      reused_prev_cols[cols] = pi;
+      cols++;
+    }
+  }
+
+  int count = 0;
+  for (int j = 0; j < v->height && cols > 0; j++) {
+    int pj = v->use_fixed ? find_fixed(prev_fixed_rows, v->height, fixed_rows[j])
+                          : find_double(prev_double_rows, v->height, double_rows[j]);
+    if (pj < 0) {
+      continue;
+    }
+    unsigned short* row = &it_buffer[j * v->width];
+    unsigned short* prev_row = &prev[pj * v->width];
+    for (int k = 0; k < cols; k++) {
+      row[reused_cols[k]] = prev_row[reused_prev_cols[k]];
+    }
+    count += cols;
+  }
+  stats.reused += count;
+}
+
+// remembers the coordinates of the frame just rendered
+void keep_frame_coords(struct view* v) {
+  for (int i = 0; i < v->width; i++) {
+    prev_double_cols[i] = double_cols[i];
+    prev_fixed_cols[i] = fixed_cols[i];
+  }
+  for (int j = 0; j < v->height; j++) {
+    prev_double_rows[j] = double_rows[j];
+    prev_fixed_rows[j] = fixed_rows[j];
+  }
+}
+
+// renders the zoom sequence of a mandelbrot or julia entry to dst, which must be aligned, and returns its end
+char* render_zoom(char type, double xmax, double xmin, double ymax, double ymin, double cx, double cy, int width, int height, struct options* opts, char* dst) {
+  struct batch_directory* dir = (struct batch_directory*) dst;
+  dir->magic = BATCH_MAGIC;
+  dir->version = BATCH_VERSION;
+  dir->count = 0;
+  char* next = align_image((char*) &dir->slots[opts->frames]);
+
+  double xc = (xmax + xmin) / 2;
+  double yc = (ymax + ymin) / 2;
+  double step_x = (xmax - xmin) / width;
+  double step_y = (ymax - ymin) / height;
+  double factor = opts->end > 0.0 ? zoom_factor(opts->end / (xmax - xmin), opts->frames - 1) : 0.5;
+  print("[INFO] Zooming '");
+  print_dec(opts->frames);
+  println("' frames");
+
+  render_report->mode = opts->mode;
+  int reusable = width * height <= IT_CACHE_SLOT_SIZE;
+  int prev_slot = -1;
+  int prev_fixed = 0;
+  int prev_max_it = 0;
+  double scale = 1.0;
+  for (int f = 0; f < opts->frames && !render_cancelled; f++) {
+    print("[INFO] Frame '");
+    print_dec(f);
+    printlnc('\'');
+
+    // the first frame is the image of the entry on its own
+    struct frame fr;
+    struct view v;
+    if (f == 0) {
+      prepare_frame(&fr, xmax, xmin, ymax, ymin, cx, cy, width, height, opts->bail);
+      setup_view(&v, type, xmax, xmin, ymax, ymin, cx, cy, width, height, &fr, opts->max_it, opts->bail, 0);
+    } else {
+      double half_x = step_x * scale * width / 2;
+      double half_y = step_y * scale * height / 2;
+      prepare_frame(&fr, xc + half_x, xc - half_x, yc + half_y, yc - half_y, cx, cy, width, height, opts->bail);
+      setup_view(&v, type, xc + half_x, xc - half_x, yc + half_y, yc - half_y, cx, cy, width, height, &fr, opts->max_it, opts->bail, 0);
+      centre_view(&v, xc, yc, step_x * scale, step_y * scale);
+    }
+    if (opts->max_it == IT_AUTO) {
+      v.max_it_count = choose_max_it(&v, step_x * scale);
+    }
+
+    char* image = next;
+    struct image_writer img;
+    begin_image(&img, &v, opts->fmt, image);
+    if (reusable) {
+      int slot = claim_cache_slot(prev_slot);
+      it_buffer = cache_slot_data(slot);
+      clear_it_buffer(width * height);
+      if (prev_slot >= 0 && prev_fixed == v.use_fixed && prev_max_it == v.max_it_count) {
+        reuse_previous_frame(&v, cache_slot_data(prev_slot));
+      }
+      begin_progress();
+      render_band(&v, opts->mode);
+      paint_band(&v, &img);
+      keep_frame_coords(&v);
+      prev_slot = slot;
+      prev_fixed = v.use_fixed;
+      prev_max_it = v.max_it_count;
+    } else {
+      render_image(&v, opts->mode, &img);
+    }
+    next = end_image(&img, &v);
+
+    struct batch_slot* slot = &dir->slots[dir->count];
+    slot->offset = image - dst;
+    slot->size = next - image;
+    slot->index = f;
+    slot->type = type;
+    slot->fmt = opts->fmt;
+    slot->width = width;
+    slot->height = height;
+    slot->max_it = v.max_it_count;
+    slot->xmax = v.xmax;
+    slot->xmin = v.xmin;
+    slot->ymax = v.ymax;
+    slot->ymin = v.ymin;
+    slot->cx = type == 'J' ? cx : 0.0;
+    slot->cy = type == 'J' ? cy : 0.0;
+    dir->count++;
+    next = align_image(next);
+    scale *= factor;
+  }
+
+  dir->size = next - dst;
+  return next;
+}
+
+// sets up the view of a single image mandelbrot entry with its iteration budget, and the reference orbit of a deep zoom
+void setup_mandelbrot_view(struct view* v, struct mandelbrot* data) {
+  // how many times we check if a value converges or diverges, chosen after setting up the view with 'it=auto;'
+  int max_it_count = data->opts.max_it;
+  setup_view(v, 'M', data->xmax, data->xmin, data->ymax, data->ymin, 0.0, 0.0, data->width, data->height, &data->frame, max_it_count, data->opts.bail, data->deep.enabled ? &data->deep : 0);
+  if (max_it_count == IT_AUTO) {
+    v->max_it_count = choose_max_it(v, data->frame.step_x);
+  } else if (data->deep.enabled) {
+    compute_reference(&data->deep, max_it_count);
+  }
+}
+
+// sets up the view of a single image julia entry with its iteration budget
+void setup_julia_view(struct view* v, struct julia* data) {
+  // how many times we check if a value converges or diverges, chosen after setting up the view with 'it=auto;'
+  int max_it_count = data->opts.max_it;
+  setup_view(v, 'J', data->xmax, data->xmin, data->ymax, data->ymin, data->real, data->imag, data->width, data->height, &data->frame, max_it_count, data->opts.bail, 0);
+  if (max_it_count == IT_AUTO) {
+    v->max_it_count = choose_max_it(v, data->frame.step_x);
+  }
+}
+
+/*
+  Writes mandelbrot data.
+
+  Mandelbrot sets are defined as z_n = z_n-1 + c,
+  where z_0 = 0+0i and c is the given (x,y) pixel,
+  where we use y to represnet the imaginary axis
+  and we use x to represent the real axis.
+  
+  We then iterate up to z_255, if the value
+  converges (that is if it cycles around), then we
+  paint it black, else we paint it some other color
+  depending on how quickly it diverges (that is if it
+  approaches infinity).
+
+  If the view fits Q4.28 (see 'fits_fixed_view') we
+  iterate in fixed-point, else we fall back to doubles.
+*/
+int write_mandelbrot_data(struct mandelbrot data, char* dst, int* size) {
+  reset_counters();
+  reset_render_stats();
+  int sz = (int) dst;
+
+  if (!check_dims(data.width, data.height, bpp_bound(&data.opts))) {
+    return 0;
+  }
+  print("[INFO] Writing Mandelbrot with resolution '");
+  print_dims(data.width, data.height);
+  printlnc('\'');
+  if (data.opts.frames > 1) {
+    if (entry_bound(data.width, data.height, &data.opts, bpp_bound(&data.opts)) > IMAGE_BUFFER_SIZE) {
+      println("[SEVERE] Zoom sequence does not fit the image buffer!");
+      return 0;
+    }
+    dst = render_zoom('M', data.xmax, data.xmin, data.ymax, data.ymin, 0.0, 0.0, data.width, data.height, &data.opts, dst);
+    *size = (int) dst - sz;
+    read_counters();
+    print_render_stats();
+    return 1;
+  }
+
+  struct view v;
+  setup_mandelbrot_view(&v, &data);
+  struct image_writer img;
+  begin_image(&img, &v, data.opts.fmt, dst);
+  render_image(&v, data.opts.mode, &img);
+  dst = end_image(&img, &v);
+
+  *size = (int) dst - sz;
+  read_counters();
+  print_render_stats();
+  return 1;
+}
+
+/*
+  Writes julia data.
+
+  Julia sets are defined as z_n = z_n-1 + c,
+  where z_0 = (x,y) of the given (x,y) pixel,
+  where we use y to represnet the imaginary axis
+  and we use x to represent the real axis. Then c 
+  is just some starting number c = a + bi.
+  
+  We then iterate up to z_255 and here we paint
+  the pixel differently depending on how quickly
+  it increases and eventually diverges or is cyclic.
+
+  Like mandelbrot we iterate in Q4.28 fixed-point
+  whenever the view and c fit, else in doubles.
+*/
+int write_julia_data(struct julia data, char* dst, int* size) {
+  reset_counters();
+  reset_render_stats();
+  int sz = (int) dst;
+
+  if (!check_dims(data.width, data.height, bpp_bound(&data.opts))) {
+    return 0;
+  }
+  print("[INFO] Writing Julia with resolution '");
+  print_dims(data.width, data.height);
+  printlnc('\'');
+  if (data.opts.frames > 1) {
+    if (entry_bound(data.width, data.height, &data.opts, bpp_bound(&data.opts)) > IMAGE_BUFFER_SIZE) {
+      println("[SEVERE] Zoom sequence does not fit the image buffer!");
+      return 0;
+    }
+    dst = render_zoom('J', data.xmax, data.xmin, data.ymax, data.ymin, data.real, data.imag, data.width, data.height, &data.opts, dst);
+    *size = (int) dst - sz;
+    read_counters();
+    print_render_stats();
+    return 1;
+  }
+
+  struct view v;
+  setup_julia_view(&v, &data);
+  struct image_writer img;
+  begin_image(&img, &v, data.opts.fmt, dst);
+  render_image(&v, data.opts.mode, &img);
+  dst = end_image(&img, &v);
+
+  *size = (int) dst - sz;
+  read_counters();
+  print_render_stats();
+  return 1;
+}
+
+
+/*
+  Sierpinski.
+
+  Cell (x,y) of the 2^depth by 2^depth grid belongs to the Sierpinski
+  triangle exactly when x & y == 0, since that is when the binomial
+  coefficient C(x+y, x) is odd (Lucas's theorem). The window picks the
+  cells of the image, whose columns and rows are mapped to cells once.
+
+  Nothing is iterated, so a render costs about as much as writing the
+  image. Pixels are painted in groups of 4, whose bytes fill a whole
+  number of words (1 for PGM, 3 for PPM), from a table of all 16 groups
+  built up front. Only the few pixels before the first aligned word and
+  after the last group are written byte by byte. A cell of the triangle
+  is painted as escape count 2 and a hole as 1, so the PGM image is 0/1
+  and expand.host paints it like we do.
+*/
+#define SIERPINSKI_IT 2
+
+// writes one sierpinski pixel in the given format, not QOI
+char* write_sierpinski_sample(char* dst, int it_count, int fmt) {
+  if (fmt == FMT_PGM) {
+    *dst = it_count - 1; dst++;
+    return dst;
+  }
+  return write_sierpinski_pixel(dst, it_count);
+}
+
+// paints every pixel of the view, whose columns and rows hold cells, to the image
+void paint_sierpinski(struct view* v, struct image_writer* img, int depth) {
+  if (img->fmt == FMT_QOI) {
+    char rgb[3];
+    for (int j = 0; j < v->height; j++) {
+      unsigned int y = fixed_rows[j];
+      for (int i = 0; i < v->width; i++) {
+        unsigned int x = fixed_cols[i];
+        int set = ((x & y) | ((x | y) >> depth)) == 0;
+        write_sierpinski_pixel(rgb, 1 + set);
+        qoi_push(img, rgb);
+      }
+    }
+    return;
+  }
+
+  // the words of 4 pixels, bit k of the index is set if pixel k is
+  union {
+    unsigned int words[3];
+    char bytes[12];
+  } groups[16];
+  for (int g = 0; g < 16; g++) {
+    char* ptr = groups[g].bytes;
+    for (int k = 0; k < 4; k++) {
+      ptr = write_sierpinski_sample(ptr, 1 + ((g >> k) & 1), img->fmt);
+    }
+  }
+
+  int words = img->bpp; // per group
+  char* dst = img->pixels;
+  int group = 0;
+  int in_group = 0;
+  for (int j = 0; j < v->height; j++) {
+    unsigned int y = fixed_rows[j];
+    for (int i = 0; i < v->width; i++) {
+      unsigned int x = fixed_cols[i];
+      // cells past the grid have bits above 'depth'
+      int set = ((x & y) | ((x | y) >> depth)) == 0;
+      if (in_group == 0 && ((int) dst & 3) != 0) {
+        dst = write_sierpinski_sample(dst, 1 + set, img->fmt);
         continue;
       }
 
-      print("[INFO] Generating image from switch '");
+      group |= set << in_group;
+      in_group++;
+      if (in_group == 4) {
+        unsigned int* out = (unsigned int*) dst;
+        for (int k = 0; k < words; k++) {
+          out[k] = groups[group].words[k];
+        }
+        dst += 4 * words;
+        group = 0;
+        in_group = 0;
+      }
+    }
+  }
+  for (int k = 0; k < in_group; k++) {
+    dst = write_sierpinski_sample(dst, 1 + ((group >> k) & 1), img->fmt);
+  }
+}
+
+int write_sierpinski_data(struct sierpinski data, char* dst, int* size) {
+  reset_counters();
+  reset_render_stats();
+  int sz = (int) dst;
+
+  if (!check_dims(data.width, data.height, format_bpp(data.opts.fmt, SIERPINSKI_IT))) {
+    return 0;
+  }
+  print("[INFO] Writing Sierpinski with resolution '");
+  print_dims(data.width, data.height);
+  printlnc('\'');
+
+  // only what the image writer needs, the cells go in the Q4.28 tables as plain ints
+  struct view v;
+  v.type = 'S';
+  v.width = data.width;
+  v.height = data.height;
+  v.max_it_count = SIERPINSKI_IT;
+  v.y0 = 0;
+  v.rows = data.height;
+  struct window* w = &data.window;
+  unsigned long long rows = udiv64((unsigned long long) w->size * data.height, data.width, 0);
+  if (rows > 1 << 30) {
+    rows = 1 << 30;
+  }
+  fill_fixed_coords(fixed_cols, w->x, w->size, data.width);
+  fill_fixed_coords(fixed_rows, w->y, (int) rows, data.height);
+  stats.pixels = data.width * data.height;
+  stats.kernel = 'I';
+
+  struct image_writer img;
+  begin_image(&img, &v, data.opts.fmt, dst);
+  paint_sierpinski(&v, &img, w->depth);
+  dst = end_image(&img, &v);
+
+  *size = (int) dst - sz;
+  read_counters();
+  print_render_stats();
+  return 1;
+}
+
+int process_image(int index, char** dst, int* size);
+
+/*
+  Benchmark.
+
+  Selecting a 'B;' entry renders every other configured entry in turn,
+  also those past the switches, each with an empty render cache so it
+  is measured on its own, and records its pixels, iterations, mcycle
+  and minstret. The results are written as a CSV table to
+  'bench_buffer' for download and summarised per pixel on the terminal.
+*/
+int run_benchmark(char** dst, int* size) {
+  char* table = bench_buffer;
+  char* ptr = table;
+  char* header = "entry,type,kernel,mode,pixels,iterations,mcycle,minstret\n";
+  while (*header != '\0') {
+    *ptr = *header; ptr++; header++;
+  }
+
+  println("[INFO] Running benchmark...");
+  for (int i = 0; i < num_entries && !render_cancelled; i++) {
+    char type = fetch_type(i);
+    if (type != 'M' && type != 'J' && type != 'S') {
+      continue;
+    }
+
+    clear_it_cache();
+    char* image = image_buffer;
+    int image_size = 0;
+    if (!process_image(i, &image, &image_size)) {
+      print("[WARNING] Benchmark skipped entry '");
       print_dec(i);
       printlnc('\'');
+      continue;
+    }
 
+    int mode = MODE_BRUTE;
+    if (type == 'M') {
+      mode = fetch_mandelbrot(i).opts.mode;
+    } else if (type == 'J') {
+      mode = fetch_julia(i).opts.mode;
+    }
+    unsigned long long mcycle = last_counters[0];
+    unsigned long long minstret = last_counters[1];
+
+    ptr = write_long(ptr, i); *ptr = ','; ptr++;
+    *ptr = type; ptr++; *ptr = ','; ptr++;
+    *ptr = stats.kernel; ptr++; *ptr = ','; ptr++;
+    *ptr = mode == MODE_MARIANI_SILVER ? 'm' : 'b'; ptr++; *ptr = ','; ptr++;
+    ptr = write_long(ptr, stats.pixels); *ptr = ','; ptr++;
+    ptr = write_long(ptr, stats.iterations); *ptr = ','; ptr++;
+    ptr = write_long(ptr, mcycle); *ptr = ','; ptr++;
+    ptr = write_long(ptr, minstret); *ptr = '\n'; ptr++;
+
+    print("[BENCH] entry ");
+    print_dec(i);
+    printc(' ');
+    printc(type);
+    printc(' ');
+    printc(stats.kernel);
+    print(" pixels=");
+    print_dec(stats.pixels);
+    print(" it/px=");
+    unsigned int frac;
+    unsigned long long whole = udiv64(udiv64(stats.iterations * 100, stats.pixels > 0 ? stats.pixels : 1, 0), 100, &frac);
+    print_long(whole);
+    printc('.');
+    printc('0' + frac / 10);
+    printc('0' + frac % 10);
+    print(" cyc/px=");
+    print_long(udiv64(mcycle, stats.pixels > 0 ? stats.pixels : 1, 0));
+    print(" instr/px=");
+    println_long(udiv64(minstret, stats.pixels > 0 ? stats.pixels : 1, 0));
+  }
+
+  *dst = table;
+  *size = ptr - table;
+  return 1;
+}
+
+// renders the entry at the given switch to *dst, which it may point elsewhere, e.g. to a table
+int process_image(int index, char** dst, int* size) {
+  char type = fetch_type(index);
+  if (type == '-') {
+    print("[WARNING] Cannot process due to bad type at switch '");
+    print_dec(index);
+    printc('\'');
+    println(", this could be due to an incorrect type or missing.");
+    return 0;
+  } else if (type == 'M') {
+    int done = write_mandelbrot_data(fetch_mandelbrot(index), *dst, size);
+    render_report->index = index;
+    return done;
+  } else if (type == 'J') {
+    int done = write_julia_data(fetch_julia(index), *dst, size);
+    render_report->index = index;
+    return done;
+  } else if (type == 'S') {
+    int done = write_sierpinski_data(fetch_sierpinski(index), *dst, size);
+    render_report->index = index;
+    return done;
+  } else if (type == 'B') {
+    return run_benchmark(dst, size);
+  }else {
+    //should never happen since we cover all cases already
+    println("[ERROR] How did we get here?");
+    return 0;
+  }
+}
+
+/*
+  Image cache.
+
+  Finished images stay where they were rendered, and a directory at
+  'image_cache' remembers which config entry each one shows, keyed by a
+  hash of the parsed entry. Pressing the button on an entry we already
+  have only points the download address at its image. New images are
+  written after the most recent one and wrap around to 'image_buffer'
+  when they might not fit, forgetting every image they may overwrite.
+
+  Unlike the render cache the directory is not static, so it survives
+  stepping out and resuming with dtekv-run. That also means it may hold
+  garbage, or images of a different build, so it is only trusted if its
+  magic, build hash and checksum match, and an image only if its own
+  checksum does.
+*/
+#define IMAGE_CACHE_MAGIC 0x494b5444 // "DTKI"
+#define IMAGE_CACHE_ENTRIES 16
+
+struct image_cache_entry {
+  unsigned int key; // hash of the config entry, 0 if empty
+  unsigned int used; // value of 'clock' when last used
+  char* data;
+  int size;
+  unsigned int checksum;
+};
+
+struct image_cache {
+  unsigned int magic;
+  unsigned int build;
+  char* next; // where the next image is written
+  unsigned int clock;
+  struct image_cache_entry entries[IMAGE_CACHE_ENTRIES];
+  unsigned int checksum; // of all fields above
+};
+
+unsigned int hash_options(unsigned int hash, struct options* opts) {
+  hash = hash_bytes(hash, &opts->mode, sizeof opts->mode);
+  hash = hash_bytes(hash, &opts->fmt, sizeof opts->fmt);
+  hash = hash_bytes(hash, &opts->max_it, sizeof opts->max_it);
+  hash = hash_bytes(hash, &opts->bail, sizeof opts->bail);
+  hash = hash_bytes(hash, &opts->frames, sizeof opts->frames);
+  hash = hash_bytes(hash, &opts->end, sizeof opts->end);
+  return hash;
+}
+
+// returns a hash of every field of the config entry at the given switch, 0 if it is not cached
+unsigned int image_key(int index) {
+  char type = fetch_type(index);
+  unsigned int hash = hash_bytes(2166136261u, &type, 1);
+  if (type == 'M') {
+    struct mandelbrot data = fetch_mandelbrot(index);
+    hash = hash_bytes(hash, &data.xmax, sizeof data.xmax);
+    hash = hash_bytes(hash, &data.xmin, sizeof data.xmin);
+    hash = hash_bytes(hash, &data.ymax, sizeof data.ymax);
+    hash = hash_bytes(hash, &data.ymin, sizeof data.ymin);
+    hash = hash_bytes(hash, &data.width, sizeof data.width);
+    hash = hash_bytes(hash, &data.height, sizeof data.height);
+    hash = hash_options(hash, &data.opts);
+    if (data.deep.enabled) {
+      hash = hash_bytes(hash, &data.deep.cx, sizeof data.deep.cx);
+      hash = hash_bytes(hash, &data.deep.cy, sizeof data.deep.cy);
+      hash = hash_bytes(hash, &data.deep.span, sizeof data.deep.span);
+    }
+  } else if (type == 'J') {
+    struct julia data = fetch_julia(index);
+    hash = hash_bytes(hash, &data.xmax, sizeof data.xmax);
+    hash = hash_bytes(hash, &data.xmin, sizeof data.xmin);
+    hash = hash_bytes(hash, &data.ymax, sizeof data.ymax);
+    hash = hash_bytes(hash, &data.ymin, sizeof data.ymin);
+    hash = hash_bytes(hash, &data.real, sizeof data.real);
+    hash = hash_bytes(hash, &data.imag, sizeof data.imag);
+    hash = hash_bytes(hash, &data.width, sizeof data.width);
+    hash = hash_bytes(hash, &data.height, sizeof data.height);
+    hash = hash_options(hash, &data.opts);
+  } else if (type == 'S') {
+    struct sierpinski data = fetch_sierpinski(index);
+    hash = hash_bytes(hash, &data.width, sizeof data.width);
+    hash = hash_bytes(hash, &data.height, sizeof data.height);
+    hash = hash_options(hash, &data.opts);
+    hash = hash_bytes(hash, &data.window, sizeof data.window);
+  } else {
+    return 0;
+  }
+  return hash != 0 ? hash : 1;
+}
+
+// returns the largest size the image of the config entry at the given switch may take
+int image_bound(int index) {
+  char type = fetch_type(index);
+  if (type == 'M') {
+    struct mandelbrot data = fetch_mandelbrot(index);
+    return entry_bound(data.width, data.height, &data.opts, bpp_bound(&data.opts));
+  } else if (type == 'J') {
+    struct julia data = fetch_julia(index);
+    return entry_bound(data.width, data.height, &data.opts, bpp_bound(&data.opts));
+  } else if (type == 'S') {
+    struct sierpinski data = fetch_sierpinski(index);
+    return data.width * data.height * format_bpp(data.opts.fmt, SIERPINSKI_IT) + 64;
+  }
+  return IMAGE_BUFFER_SIZE;
+}
+
+unsigned int image_cache_checksum() {
+  return checksum_bytes(image_cache, (char*) &image_cache->checksum - (char*) image_cache);
+}
+
+// empties the image cache
+void clear_image_cache() {
+  image_cache->magic = IMAGE_CACHE_MAGIC;
+  image_cache->build = build_hash();
+  image_cache->next = image_buffer;
+  image_cache->clock = 0;
+  for (int e = 0; e < IMAGE_CACHE_ENTRIES; e++) {
+    image_cache->entries[e].key = 0;
+  }
+  image_cache->checksum = image_cache_checksum();
+}
+
+// returns 1 if the image cache directory is intact and was written by this very build
+int image_cache_valid() {
+  return image_cache->magic == IMAGE_CACHE_MAGIC && image_cache->build == build_hash()
+    && image_cache->checksum == image_cache_checksum();
+}
+
+// points *dst at the cached image of the entry at the given switch and returns 1, or returns 0
+int find_cached_image(int index, char** dst, int* size) {
+  unsigned int key = image_key(index);
+  if (key == 0 || !image_cache_valid()) {
+    return 0;
+  }
+  for (int e = 0; e < IMAGE_CACHE_ENTRIES; e++) {
+    struct image_cache_entry* entry = &image_cache->entries[e];
+    if (entry->key != key) {
+      continue;
+    }
+    if (entry->data < image_buffer || entry->size < 0 || entry->size > image_buffer + IMAGE_BUFFER_SIZE - entry->data
+        || checksum_bytes(entry->data, entry->size) != entry->checksum) {
+      println("[WARNING] Cached image is corrupt, rendering it again");
+      entry->key = 0;
+      image_cache->checksum = image_cache_checksum();
+      return 0;
+    }
+    *dst = entry->data;
+    *size = entry->size;
+    entry->used = ++image_cache->clock;
+    image_cache->checksum = image_cache_checksum();
+    return 1;
+  }
+  return 0;
+}
+
+// returns where to write the image of the entry at the given switch, forgetting every cached image it may overwrite
+char* claim_image_space(int index) {
+  if (!image_cache_valid()) {
+    clear_image_cache();
+  }
+  if (fetch_type(index) == 'B') {
+    // the benchmark renders every entry at 'image_buffer'
+    clear_image_cache();
+    return image_buffer;
+  }
+
+  int bound = image_bound(index);
+  char* dst = align_image(image_cache->next);
+  if (bound > image_buffer + IMAGE_BUFFER_SIZE - dst) {
+    dst = image_buffer;
+  }
+  for (int e = 0; e < IMAGE_CACHE_ENTRIES; e++) {
+    struct image_cache_entry* entry = &image_cache->entries[e];
+    if (entry->key != 0 && entry->data < dst + bound && dst < entry->data + entry->size) {
+      entry->key = 0;
+    }
+  }
+  image_cache->next = dst;
+  image_cache->checksum = image_cache_checksum();
+  return dst;
+}
+
+// remembers the image of the entry at the given switch, which was written to the space claimed for it
+void store_cached_image(int index, char* data, int size) {
+  unsigned int key = image_key(index);
+  if (key == 0 || data != image_cache->next) {
+    return;
+  }
+
+  // take an empty entry, else the least recently used one
+  int slot = 0;
+  for (int e = 0; e < IMAGE_CACHE_ENTRIES; e++) {
+    struct image_cache_entry* entry = &image_cache->entries[e];
+    if (entry->key == 0) {
+      slot = e;
+      break;
+    }
+    if (entry->used < image_cache->entries[slot].used) {
+      slot = e;
+    }
+  }
+
+  struct image_cache_entry* entry = &image_cache->entries[slot];
+  entry->key = key;
+  entry->used = ++image_cache->clock;
+  entry->data = data;
+  entry->size = size;
+  entry->checksum = checksum_bytes(data, size);
+  // keep images word aligned for 'checksum_bytes'
+  image_cache->next = data + ((size + 3) & ~3);
+  image_cache->checksum = image_cache_checksum();
+}
+
+/*
+  Batch.
+
+  Pressing the button with every switch off renders every entry of the
+  config, not only those on the switches, into consecutive slots after a
+  directory at 'image_buffer', see batch.h. One download then fetches
+  them all. The batch takes over the images of the image cache, which is
+  cleared, and skips every entry that might not fit what is left.
+*/
+
+int run_batch(char** dst, int* size) {
+  struct batch_directory* dir = (struct batch_directory*) image_buffer;
+  char* end = image_buffer + IMAGE_BUFFER_SIZE;
+  char* next = align_image((char*) &dir->slots[num_entries]);
+  clear_image_cache();
+  dir->magic = BATCH_MAGIC;
+  dir->version = BATCH_VERSION;
+  dir->count = 0;
+
+  println("[INFO] Rendering every entry as a batch...");
+  for (int i = 0; i < num_entries && !render_cancelled; i++) {
+    char type = fetch_type(i);
+    if (type != 'M' && type != 'J' && type != 'S') {
+      continue;
+    }
+    if (image_bound(i) > end - next) {
+      print("[WARNING] Skipping entry '");
+      print_dec(i);
+      println("', it might not fit what is left of the batch");
+      continue;
+    }
+
+    print("[INFO] Batch entry '");
+    print_dec(i);
+    printlnc('\'');
+    char* image = next;
+    int image_size = 0;
+    if (!process_image(i, &image, &image_size) || render_cancelled) {
+      continue;
+    }
+
+    struct batch_slot* slot = &dir->slots[dir->count];
+    slot->offset = image - image_buffer;
+    slot->size = image_size;
+    slot->index = i;
+    slot->type = type;
+    slot->xmax = slot->xmin = slot->ymax = slot->ymin = 0.0;
+    slot->cx = slot->cy = 0.0;
+    if (type == 'M') {
+      struct mandelbrot data = fetch_mandelbrot(i);
+      slot->fmt = data.opts.fmt;
+      slot->width = data.width;
+      slot->height = data.height;
+      slot->max_it = data.opts.max_it;
+      slot->xmax = data.xmax;
+      slot->xmin = data.xmin;
+      slot->ymax = data.ymax;
+      slot->ymin = data.ymin;
+    } else if (type == 'J') {
+      struct julia data = fetch_julia(i);
+      slot->fmt = data.opts.fmt;
+      slot->width = data.width;
+      slot->height = data.height;
+      slot->max_it = data.opts.max_it;
+      slot->xmax = data.xmax;
+      slot->xmin = data.xmin;
+      slot->ymax = data.ymax;
+      slot->ymin = data.ymin;
+      slot->cx = data.real;
+      slot->cy = data.imag;
+    } else {
+      struct sierpinski data = fetch_sierpinski(i);
+      slot->fmt = data.opts.fmt;
+      slot->width = data.width;
+      slot->height = data.height;
+      slot->max_it = SIERPINSKI_IT;
+    }
+    dir->count++;
+    next = align_image(image + image_size);
+  }
+
+  dir->size = next - image_buffer;
+  print("[INFO] Batch holds '");
+  print_dec(dir->count);
+  println("' images, split it with split.host");
+  *dst = image_buffer;
+  *size = dir->size;
+  return 1;
+}
+
+// the benchmark writes its header and a line per entry, each far shorter than this
+#define BENCH_LINE_BOUND 128
+
+// returns 1 if everything kept in the regions of regions.lds fits them, the linker only knows their addresses
+int check_regions() {
+  int fits = 1;
+  if (align8(sizeof(struct arena_header)) + MAX_ENTRIES * sizeof(struct datakey) > ARENA_SIZE) {
+    println("[SEVERE] The config datamap does not fit the arena region!");
+    fits = 0;
+  }
+  if (sizeof(struct render_report) > report_end - (char*) render_report) {
+    println("[SEVERE] The render report does not fit its region!");
+    fits = 0;
+  }
+  if (sizeof(struct image_cache) > image_cache_end - (char*) image_cache) {
+    println("[SEVERE] The image cache directory does not fit its region!");
+    fits = 0;
+  }
+  if (IT_CACHE_SLOTS * IT_CACHE_SLOT_SIZE * sizeof(unsigned short) > it_cache_end - (char*) it_cache_data) {
+    println("[SEVERE] The render cache does not fit its region!");
+    fits = 0;
+  }
+  if ((MAX_ENTRIES + 1) * BENCH_LINE_BOUND > bench_end - bench_buffer) {
+    println("[SEVERE] The benchmark table does not fit its region!");
+    fits = 0;
+  }
+  return fits;
+}
+
+int main() {
+  hal_init();
+
+  if (!check_regions()) {
+    println("[SEVERE] Fix the sizes in regions.lds and rebuild!");
+    console_flush();
+    return 1;
+  }
+
+  print("[INFO] Config buffer address: ");
+  println_hex32((int) cfg_ptr);
+
+  println("[INFO] Loading config...");
+
+  load_cfg(cfg_ptr);
+
+  println("[INFO] Config loaded!");
+
+  println("[INFO] Select a switch and press the BUTTON to generate an image!");
+  println("[INFO] Press the BUTTON with every switch off to generate all of them!");
+  println("[INFO] Pressing the BUTTON while rendering cancels the render and starts the new selection");
+  hal_enable_input();
+
+  while (1) {
+    console_flush();
+    hal_wait(&input_pending);
+    input_pending = 0;
+    if (switches_changed && !button_pressed) {
+      switches_changed = 0;
+      int i = get_sw_i();
+      if (i < 0) {
+        println("[INFO] No switch selected, the BUTTON renders every entry");
+      } else {
+        print("[INFO] Switch '");
+        print_dec(i);
+        println("' selected");
+      }
+    }
+
+    if (button_pressed) {
+      button_pressed = 0;
+      switches_changed = 0;
+      render_cancelled = 0;
+      rendering = 1;
+
+      int i = get_sw_i();
       int size = 0;
+      char* dst = image_buffer;
+      int done;
+
+      if (i < 0) {
+        done = run_batch(&dst, &size);
+      } else {
+        print("[INFO] Generating image from switch '");
+        print_dec(i);
+        printlnc('\'');
+        done = find_cached_image(i, &dst, &size);
+        if (done) {
+          println("[INFO] Image is cached, nothing to render");
+        } else {
+          dst = claim_image_space(i);
+
+          print("[INFO] Initiating writing data to '");
+          print_hex32((int)dst);
+          println("'!");
+
+          done = process_image(i,&dst,&size);
+          if (done && !render_cancelled) {
+            store_cached_image(i, dst, size);
+          }
+        }
+      }
+      rendering = 0;
 
-      print("[INFO] Initiating writing data to '");
-      print_hex32((int)image_buffer);
-      println("'!");
-      
-      if (process_image(i,image_buffer,&size)) {
+      if (render_cancelled) {
+        println("[WARNING] Render cancelled, starting the new selection");
+      } else if (done) {
         print("[INFO] Finished writing data to '");
-        print_hex32((int)image_buffer);
+        print_hex32((int)dst);
         print("' with size of '");
         print_hex32(size);
         println("'-bytes!");
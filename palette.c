@@ -0,0 +1,33 @@
+#include "palette.h"
+
+char* write_mandelbrot_pixel(char* dst, int it_count, int max_it_count) {
+  //paint black if value does not diverge
+  if (max_it_count <= it_count) {
+    *dst = 0; dst++;
+    *dst = 0; dst++;
+    *dst = 0; dst++;
+  }
+  //paint some other color if value diverges
+  //we can use 'it_count' to represent how quickly said value diverges
+  else {
+    *dst = (it_count >> 2) % 256; dst++;
+    *dst = it_count % 256; dst++;
+    *dst = (it_count + 10) % 256; dst++;
+  }
+  return dst;
+}
+
+char* write_julia_pixel(char* dst, int it_count) {
+  *dst = 255 - (it_count % 256); dst++;
+  *dst = 255 - (it_count*2 % 256); dst++;
+  *dst = 255 - (it_count*4 % 256); dst++;
+  return dst;
+}
+
+char* write_sierpinski_pixel(char* dst, int it_count) {
+  char shade = it_count >= 2 ? 255 : 0;
+  *dst = shade; dst++;
+  *dst = shade; dst++;
+  *dst = shade; dst++;
+  return dst;
+}
@@ -0,0 +1,17 @@
+/*
+  Colour palettes.
+
+  The colour of every pixel is a function of its escape iteration count
+  only. The palettes live here so that both the firmware and the host
+  expander (host/expand.c), which turns indexed PGM images back into the
+  PPM images the firmware would have written, paint exactly alike.
+*/
+
+// writes one mandelbrot pixel (P6) colored by how quickly it diverged
+char* write_mandelbrot_pixel(char* dst, int it_count, int max_it_count);
+
+// writes one julia pixel (P6) colored by how quickly it diverged
+char* write_julia_pixel(char* dst, int it_count);
+
+// writes one sierpinski pixel (P6), 'it_count' is 2 for a cell of the triangle and 1 for a hole
+char* write_sierpinski_pixel(char* dst, int it_count);
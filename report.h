@@ -0,0 +1,67 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+/*
+  Render report.
+
+  Every render fills this report at 0x248000, right behind the config
+  arena, where it stays until the next render. The firmware prints it
+  in compact form when the render is done, and downloading 'size' bytes
+  from that address lets 'report.host' (host/report.c) print all of it:
+  dtekv-download report.bin 0x248000 <size>
+
+  The histogram and the interior and escaped counts cover every pixel of
+  the image, also those filled, reused or mirrored without iterating. A
+  sierpinski render has no escape counts and leaves them empty. The rows
+  are the most expensive spans of rows by iterations, single rows for
+  brute force and tile rows for Mariani-Silver. A zoom sequence reports
+  all of its frames together.
+
+  Every field is an int or a 64-bit integer in 8-byte aligned spots, so
+  the layout is the same for rv32 (ilp32) and x86-64 Linux.
+*/
+#include "hal.h"
+
+#define REPORT_MAGIC 0x524b5444 // "DTKR"
+#define REPORT_VERSION 1
+#define REPORT_BUCKETS 256
+#define REPORT_ROWS 8
+
+struct report_rows {
+  int y; // first row of the span
+  int rows;
+  unsigned long long iterations;
+};
+
+struct render_report {
+  unsigned int magic;
+  int version;
+  int size; // of the report
+  int index; // of the config entry
+  int type; // 'M', 'J' or 'S'
+  int kernel; // 'Q' for Q4.28, 'D' for double, 'P' for perturbation, 'I' for integers
+  int mode; // MODE_BRUTE or MODE_MARIANI_SILVER
+  int width;
+  int height;
+  int max_it; // of the last view rendered
+
+  unsigned long long iterations;
+  unsigned long long period_saved; // iterations the periodicity check did not run
+  // deltas over the render, mcycle, minstret, mhpmcounter3..9
+  unsigned long long counters[HAL_COUNTERS];
+
+  int pixels;
+  int interior; // never escaped within the iteration limit
+  int escaped;
+  int culled;
+  int periodic;
+  int filled;
+  int reused;
+  int mirrored;
+  int frames; // of a zoom sequence, else 1
+  int bucket_width; // escape counts per histogram bucket, from 1 up
+  int histogram[REPORT_BUCKETS];
+  struct report_rows rows[REPORT_ROWS]; // most expensive first, 'rows' 0 for unused
+};
+
+#endif